@@ -1,5 +1,5 @@
-#include <array>
 #include "DrawingWindow.h"
+#include "SimdKernels.h"
 // On some platforms you may need to include <cstring> (if you compiler can't find memset !)
 
 DrawingWindow::DrawingWindow() {}
@@ -24,7 +24,10 @@ DrawingWindow::DrawingWindow(int w, int h, bool fullscreen) : width(w), height(h
 	if (!texture) printMessageAndQuit("Could not allocate texture: ", SDL_GetError());
 }
 
+DrawingWindow::DrawingWindow(int w, int h) : width(w), height(h), pixelBuffer(w * h) {}
+
 void DrawingWindow::renderFrame() {
+	if (!texture) return;
 	SDL_UpdateTexture(texture, nullptr, pixelBuffer.data(), width * sizeof(uint32_t));
 	SDL_RenderClear(renderer);
 	SDL_RenderCopy(renderer, texture, nullptr, nullptr);
@@ -39,19 +42,15 @@ void DrawingWindow::saveBMP(const std::string &filename) const {
 }
 
 void DrawingWindow::savePPM(const std::string &filename) const {
-	std::ofstream outputStream(filename, std::ofstream::out);
+	std::ofstream outputStream(filename, std::ofstream::out | std::ofstream::binary);
 	outputStream << "P6\n";
 	outputStream << width << " " << height << "\n";
 	outputStream << "255\n";
 
-	for (size_t i = 0; i < width * height; i++) {
-		std::array<char, 3> rgb {{
-				static_cast<char> ((pixelBuffer[i] >> 16) & 0xFF),
-				static_cast<char> ((pixelBuffer[i] >> 8) & 0xFF),
-				static_cast<char> ((pixelBuffer[i] >> 0) & 0xFF)
-		}};
-		outputStream.write(rgb.data(), 3);
-	}
+	// converted all at once and written in one go
+	std::vector<unsigned char> rgb(pixelBuffer.size() * 3);
+	simdKernels().argbToRgb(pixelBuffer.data(), rgb.data(), pixelBuffer.size());
+	outputStream.write(reinterpret_cast<const char *>(rgb.data()), rgb.size());
 	outputStream.close();
 }
 
@@ -86,8 +85,14 @@ uint32_t DrawingWindow::getPixelColour(size_t x, size_t y) {
 	} else return pixelBuffer[(y * width) + x];
 }
 
+void DrawingWindow::fillSpan(size_t x, size_t y, size_t count, uint32_t colour) {
+	if ((x + count > width) || (y >= height)) {
+		std::cout << x << "-" << x + count << "," << y << " not on visible screen area" << std::endl;
+	} else simdKernels().fillSpan(&pixelBuffer[(y * width) + x], count, colour);
+}
+
 void DrawingWindow::clearPixels() {
-	std::fill(pixelBuffer.begin(), pixelBuffer.end(), 0);
+	simdKernels().fillSpan(pixelBuffer.data(), pixelBuffer.size(), 0);
 }
 
 void printMessageAndQuit(const std::string &message, const char *error) {
@@ -12,19 +12,23 @@ public:
 	size_t height;
 
 private:
-	SDL_Window *window;
-	SDL_Renderer *renderer;
-	SDL_Texture *texture;
+	SDL_Window *window{};
+	SDL_Renderer *renderer{};
+	SDL_Texture *texture{};
 	std::vector<uint32_t> pixelBuffer;
 
 public:
 	DrawingWindow();
 	DrawingWindow(int w, int h, bool fullscreen);
+	// Offscreen window: only the pixel buffer is allocated, nothing is shown (used for benchmarks and batch runs)
+	DrawingWindow(int w, int h);
 	void renderFrame();
 	void savePPM(const std::string &filename) const;
 	void saveBMP(const std::string &filename) const;
 	bool pollForInputEvents(SDL_Event &event);
 	void setPixelColour(size_t x, size_t y, uint32_t colour);
+	// Sets `count` pixels of row y from x on
+	void fillSpan(size_t x, size_t y, size_t count, uint32_t colour);
 	uint32_t getPixelColour(size_t x, size_t y);
 	void clearPixels();
 };
@@ -0,0 +1,125 @@
+#include "SimdKernels.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// SimdKernelsSse2.cpp, SimdKernelsAvx2.cpp and SimdKernelsAvx512.cpp
+extern const SimdKernels sse2Kernels, avx2Kernels, avx512Kernels;
+
+namespace {
+	// Per level, with the kernels a level's file leaves out filled in from the level below
+	const SimdKernels *tables() {
+		static const SimdKernels *filled = []() {
+			static SimdKernels levels[SIMD_LEVEL_COUNT] = {sse2Kernels, avx2Kernels, avx512Kernels};
+			for (int level = 1; level < SIMD_LEVEL_COUNT; level++) {
+				const SimdKernels &below = levels[level - 1];
+				SimdKernels &kernels = levels[level];
+				if (!kernels.rgbToArgb) kernels.rgbToArgb = below.rgbToArgb;
+				if (!kernels.argbToRgb) kernels.argbToRgb = below.argbToRgb;
+				if (!kernels.fillSpan) kernels.fillSpan = below.fillSpan;
+				if (!kernels.closestTriangle) kernels.closestTriangle = below.closestTriangle;
+			}
+			return levels;
+		}();
+		return filled;
+	}
+
+#ifdef SIMD_X86
+	// eax, ebx, ecx and edx of cpuid leaf `leaf`
+	void cpuid(unsigned leaf, unsigned subleaf, unsigned registers[4]) {
+#if defined(_MSC_VER)
+		int values[4];
+		__cpuidex(values, int(leaf), int(subleaf));
+		for (int i = 0; i < 4; i++) registers[i] = unsigned(values[i]);
+#else
+		__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+	}
+
+	// XCR0: the register states the OS saves on a context switch, without which the registers can't be used
+	uint64_t savedStates() {
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		unsigned low, high;
+		__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		return (uint64_t(high) << 32) | low;
+#endif
+	}
+#endif
+
+	std::atomic<int> &currentLevel() {
+		static std::atomic<int> level([]() {
+			SimdLevel detected = detectSimdLevel();
+			const char *name = std::getenv("REDNOISE_SIMD");
+			if (!name) return int(detected);
+			try {
+				SimdLevel requested = parseSimdLevel(name);
+				if (requested <= detected) return int(requested);
+				std::cerr << "REDNOISE_SIMD: this CPU doesn't support " << name << ", using " << simdLevelName(detected) << std::endl;
+			} catch (const std::invalid_argument &error) {
+				std::cerr << "REDNOISE_SIMD: " << error.what() << std::endl;
+			}
+			return int(detected);
+		}());
+		return level;
+	}
+}
+
+SimdLevel detectSimdLevel() {
+#ifdef SIMD_X86
+	unsigned registers[4];
+	cpuid(0, 0, registers);
+	if (registers[0] < 7) return SIMD_SSE2;
+	cpuid(1, 0, registers);
+	bool fma = registers[2] & (1u << 12), osxsave = registers[2] & (1u << 27), avx = registers[2] & (1u << 28);
+	if (!fma || !osxsave || !avx) return SIMD_SSE2;
+	uint64_t states = savedStates();
+	cpuid(7, 0, registers);
+	bool avx2 = registers[1] & (1u << 5);
+	// XMM and YMM registers
+	if (!avx2 || (states & 0x6) != 0x6) return SIMD_SSE2;
+	bool avx512 = (registers[1] & (1u << 16)) && (registers[1] & (1u << 30)) && (registers[1] & (1u << 31));
+	// and the opmask registers and both halves of the ZMM ones
+	if (!avx512 || (states & 0xE6) != 0xE6) return SIMD_AVX2;
+	return SIMD_AVX512;
+#else
+	return SIMD_SSE2;
+#endif
+}
+
+const SimdKernels &simdKernels() {
+	return tables()[currentLevel().load(std::memory_order_relaxed)];
+}
+
+SimdLevel simdLevel() {
+	return SimdLevel(currentLevel().load(std::memory_order_relaxed));
+}
+
+void setSimdLevel(SimdLevel level) {
+	if (level > detectSimdLevel())
+		throw std::invalid_argument("This CPU doesn't support " + std::string(simdLevelName(level)));
+	currentLevel().store(level, std::memory_order_relaxed);
+}
+
+const char *simdLevelName(SimdLevel level) {
+	static const char *names[SIMD_LEVEL_COUNT] = {"sse2", "avx2", "avx512"};
+	return names[level];
+}
+
+SimdLevel parseSimdLevel(const std::string &name) {
+	for (int level = 0; level < SIMD_LEVEL_COUNT; level++) {
+		if (name == simdLevelName(SimdLevel(level))) return SimdLevel(level);
+	}
+	throw std::invalid_argument("Unknown SIMD level `" + name + "`, expected sse2, avx2 or avx512");
+}
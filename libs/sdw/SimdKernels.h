@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct ModelTriangle;
+
+// Instruction sets the hot kernels are compiled for. The best one the CPU (and OS) supports is picked with cpuid
+// the first time a kernel is used, so one binary runs everywhere; REDNOISE_SIMD=<name> or --simd <name> picks a
+// lower one, e.g. to test that path.
+enum SimdLevel {
+	SIMD_SSE2,    // the x86-64 baseline (and whatever the compiler targets by default elsewhere)
+	SIMD_AVX2,    // AVX2 + FMA
+	SIMD_AVX512,  // AVX-512 F, BW and VL
+	SIMD_LEVEL_COUNT
+};
+
+// One build of every kernel
+struct SimdKernels {
+	// 8 bit RGB triples to opaque ARGB8888
+	void (*rgbToArgb)(const unsigned char *rgb, uint32_t *argb, size_t count);
+	// ARGB8888 to 8 bit RGB triples, dropping alpha
+	void (*argbToRgb)(const uint32_t *argb, unsigned char *rgb, size_t count);
+	void (*fillSpan)(uint32_t *pixels, size_t count, uint32_t colour);
+	// Index of the nearest triangle hit in front of `origin` along `direction` (3 floats each), skipping triangle
+	// `skip`, or -1. `hit` gets its distance and barycentric coordinates along the triangle's first two edges.
+	size_t (*closestTriangle)(const ModelTriangle *triangles, size_t count, const float *origin, const float *direction, size_t skip, float *hit);
+};
+
+// The kernels of the current level
+const SimdKernels &simdKernels();
+SimdLevel simdLevel();
+// The best level this CPU supports
+SimdLevel detectSimdLevel();
+// Throws std::invalid_argument if the CPU doesn't support `level`
+void setSimdLevel(SimdLevel level);
+
+const char *simdLevelName(SimdLevel level);
+// Throws std::invalid_argument for anything but sse2, avx2 or avx512
+SimdLevel parseSimdLevel(const std::string &name);
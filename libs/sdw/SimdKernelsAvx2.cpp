@@ -0,0 +1,2 @@
+#define SIMD_KERNELS avx2Kernels
+#include "SimdKernelsImpl.h"
@@ -0,0 +1,2 @@
+#define SIMD_KERNELS avx512Kernels
+#include "SimdKernelsImpl.h"
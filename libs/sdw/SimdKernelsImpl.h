@@ -0,0 +1,167 @@
+// The body of SimdKernelsSse2.cpp, SimdKernelsAvx2.cpp and SimdKernelsAvx512.cpp: each file is compiled with its own
+// instruction set flags (see CMakeLists.txt) and defines SIMD_KERNELS, the name of its table, before including this.
+//
+// Nothing here may call an inline function that other files use too (glm, the standard library): the linker keeps
+// a single copy of those, which could be the one built for AVX-512.
+#include "SimdKernels.h"
+#include "ModelTriangle.h"
+#include <cfloat>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define SIMD_LANES 8
+#else
+#define SIMD_LANES 4
+#endif
+
+namespace {
+	void rgbToArgb(const unsigned char *rgb, uint32_t *argb, size_t count) {
+		size_t i = 0;
+#if defined(__AVX512BW__) || defined(__AVX2__)
+		// 4 texels (12 bytes) into every 128 bit lane, where a shuffle moves them into place; the last lane's load
+		// reads 16 bytes for 12, so these stop 6 texels from the end
+		const __m128i order = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+#endif
+#if defined(__AVX512BW__)
+		// (the masked forms only because GCC warns about the unmasked ones' undefined inputs)
+		const __m512i order512 = _mm512_maskz_broadcast_i32x4(0xFFFF, order);
+		const __m512i alpha = _mm512_set1_epi32(int(0xFF000000));
+		for (; i + 18 <= count; i += 16) {
+			const unsigned char *block = rgb + 3 * i;
+			__m512i texels = _mm512_castsi128_si512(_mm_loadu_si128(reinterpret_cast<const __m128i *>(block)));
+			texels = _mm512_inserti32x4(texels, _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 12)), 1);
+			texels = _mm512_inserti32x4(texels, _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 24)), 2);
+			texels = _mm512_inserti32x4(texels, _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 36)), 3);
+			texels = _mm512_or_si512(_mm512_shuffle_epi8(texels, order512), alpha);
+			_mm512_storeu_si512(argb + i, texels);
+		}
+#elif defined(__AVX2__)
+		const __m256i order256 = _mm256_broadcastsi128_si256(order);
+		const __m256i alpha = _mm256_set1_epi32(int(0xFF000000));
+		for (; i + 10 <= count; i += 8) {
+			const unsigned char *block = rgb + 3 * i;
+			__m256i texels = _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(block)));
+			texels = _mm256_inserti128_si256(texels, _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 12)), 1);
+			texels = _mm256_or_si256(_mm256_shuffle_epi8(texels, order256), alpha);
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(argb + i), texels);
+		}
+#endif
+		for (; i < count; i++) {
+			const unsigned char *texel = rgb + 3 * i;
+			argb[i] = (255u << 24) + (uint32_t(texel[0]) << 16) + (uint32_t(texel[1]) << 8) + texel[2];
+		}
+	}
+
+	void argbToRgb(const uint32_t *argb, unsigned char *rgb, size_t count) {
+		size_t i = 0;
+#if defined(__AVX512BW__) || defined(__AVX2__)
+		// every lane's 4 pixels to 12 bytes at its bottom, then the lanes' bytes packed together
+		const __m128i order = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+#endif
+#if defined(__AVX512BW__)
+		const __m512i order512 = _mm512_maskz_broadcast_i32x4(0xFFFF, order);
+		const __m512i pack = _mm512_setr_epi32(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 3, 7, 11, 15);
+		for (; i + 16 <= count; i += 16) {
+			__m512i pixels = _mm512_shuffle_epi8(_mm512_loadu_si512(argb + i), order512);
+			_mm512_mask_storeu_epi8(rgb + 3 * i, __mmask64(0xFFFFFFFFFFFF), _mm512_maskz_permutexvar_epi32(0xFFFF, pack, pixels));
+		}
+#elif defined(__AVX2__)
+		const __m256i order256 = _mm256_broadcastsi128_si256(order);
+		const __m256i pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+		const __m256i mask = _mm256_setr_epi32(-1, -1, -1, -1, -1, -1, 0, 0);
+		for (; i + 8 <= count; i += 8) {
+			__m256i pixels = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(argb + i)), order256);
+			_mm256_maskstore_epi32(reinterpret_cast<int *>(rgb + 3 * i), mask, _mm256_permutevar8x32_epi32(pixels, pack));
+		}
+#endif
+		for (; i < count; i++) {
+			rgb[3 * i] = static_cast<unsigned char>(argb[i] >> 16);
+			rgb[3 * i + 1] = static_cast<unsigned char>(argb[i] >> 8);
+			rgb[3 * i + 2] = static_cast<unsigned char>(argb[i]);
+		}
+	}
+
+	void fillSpan(uint32_t *pixels, size_t count, uint32_t colour) {
+		size_t i = 0;
+#if defined(__AVX512F__)
+		const __m512i value = _mm512_set1_epi32(int(colour));
+		for (; i + 16 <= count; i += 16) _mm512_storeu_si512(pixels + i, value);
+		// the rest with one masked store
+		_mm512_mask_storeu_epi32(pixels + i, __mmask16((1u << (count - i)) - 1), value);
+		i = count;
+#elif defined(__AVX2__)
+		const __m256i value = _mm256_set1_epi32(int(colour));
+		for (; i + 8 <= count; i += 8) _mm256_storeu_si256(reinterpret_cast<__m256i *>(pixels + i), value);
+#elif defined(__SSE2__) || defined(_M_X64)
+		const __m128i value = _mm_set1_epi32(int(colour));
+		for (; i + 4 <= count; i += 4) _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + i), value);
+#endif
+		for (; i < count; i++) pixels[i] = colour;
+	}
+
+#if !defined(__AVX512F__)
+	// Moller-Trumbore on SIMD_LANES triangles at a time: their vertices are copied into one array per coordinate
+	// first, so the compiler can turn the loop over the lanes into vector instructions as wide as the file's
+	size_t closestTriangle(const ModelTriangle *triangles, size_t count, const float *origin, const float *direction, size_t skip, float *hit) {
+		size_t closest = size_t(-1);
+		float closestDistance = FLT_MAX, closestU = 0, closestV = 0;
+		for (size_t first = 0; first < count; first += SIMD_LANES) {
+			size_t block = count - first < SIMD_LANES ? count - first : SIMD_LANES;
+			// lanes past the end repeat the last triangle and are ignored
+			const ModelTriangle *lanes[SIMD_LANES];
+			for (size_t k = 0; k < SIMD_LANES; k++) lanes[k] = &triangles[first + (k < block ? k : block - 1)];
+			float v0[3][SIMD_LANES], e0[3][SIMD_LANES], e1[3][SIMD_LANES];
+			for (size_t k = 0; k < SIMD_LANES; k++) {
+				const float *vertices = reinterpret_cast<const float *>(&lanes[k]->vertices);
+				for (int c = 0; c < 3; c++) {
+					v0[c][k] = vertices[c];
+					e0[c][k] = vertices[3 + c] - vertices[c];
+					e1[c][k] = vertices[6 + c] - vertices[c];
+				}
+			}
+
+			float distance[SIMD_LANES], u[SIMD_LANES], v[SIMD_LANES];
+			for (size_t k = 0; k < SIMD_LANES; k++) {
+				float px = direction[1] * e1[2][k] - direction[2] * e1[1][k];
+				float py = direction[2] * e1[0][k] - direction[0] * e1[2][k];
+				float pz = direction[0] * e1[1][k] - direction[1] * e1[0][k];
+				// 0 for rays parallel to the triangle, whose infinities and NaNs then fail every test below
+				float inverse = 1 / (e0[0][k] * px + e0[1][k] * py + e0[2][k] * pz);
+				float sx = origin[0] - v0[0][k], sy = origin[1] - v0[1][k], sz = origin[2] - v0[2][k];
+				float qx = sy * e0[2][k] - sz * e0[1][k];
+				float qy = sz * e0[0][k] - sx * e0[2][k];
+				float qz = sx * e0[1][k] - sy * e0[0][k];
+				u[k] = (sx * px + sy * py + sz * pz) * inverse;
+				v[k] = (direction[0] * qx + direction[1] * qy + direction[2] * qz) * inverse;
+				float t = (e1[0][k] * qx + e1[1][k] * qy + e1[2][k] * qz) * inverse;
+				// misses (and behind the origin) as FLT_MAX, which never counts as nearer
+				bool hits = (u[k] >= 0) & (v[k] >= 0) & (u[k] + v[k] <= 1) & (t > 0);
+				distance[k] = hits ? t : FLT_MAX;
+			}
+
+			// in triangle order, so the first of equally near triangles wins like it always has
+			for (size_t k = 0; k < block; k++) {
+				if (distance[k] < closestDistance && first + k != skip) {
+					closest = first + k;
+					closestDistance = distance[k];
+					closestU = u[k];
+					closestV = v[k];
+				}
+			}
+		}
+		hit[0] = closestDistance;
+		hit[1] = closestU;
+		hit[2] = closestV;
+		return closest;
+	}
+#else
+	// Left to the AVX2 build: gathering 16 triangles' vertices costs more than the wider arithmetic saves, AVX-512
+	// builds of this measured ~20% slower
+	const auto closestTriangle = nullptr;
+#endif
+}
+
+// kernels left null here are taken from the level below
+extern const SimdKernels SIMD_KERNELS = {&rgbToArgb, &argbToRgb, &fillSpan, closestTriangle};
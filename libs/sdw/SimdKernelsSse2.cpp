@@ -0,0 +1,2 @@
+#define SIMD_KERNELS sse2Kernels
+#include "SimdKernelsImpl.h"
@@ -1,32 +1,137 @@
 #include "TextureMap.h"
+#include "SimdKernels.h"
+#include <algorithm>
+#include <cctype>
+#include <limits>
 
 TextureMap::TextureMap() = default;
+namespace {
+	// Skips whitespace and `#` comments (which run to the end of the line) in a PPM header
+	void skipSeparators(std::istream &inputStream) {
+		while (true) {
+			int next = inputStream.peek();
+			if (next == '#') while (next != EOF && next != '\n') next = inputStream.get();
+			else if (std::isspace(next)) inputStream.get();
+			else return;
+		}
+	}
+
+	size_t readHeaderValue(std::istream &inputStream, const std::string &filename, const char *name) {
+		skipSeparators(inputStream);
+		size_t value = 0;
+		if (!std::isdigit(inputStream.peek()))
+			throw std::invalid_argument("Failed to parse the " + std::string(name) + " of `" + filename + "`");
+		while (std::isdigit(inputStream.peek())) {
+			if (value > (std::numeric_limits<size_t>::max() - 9) / 10)
+				throw std::invalid_argument("The " + std::string(name) + " of `" + filename + "` is too large");
+			value = value * 10 + (inputStream.get() - '0');
+		}
+		return value;
+	}
+
+	// Any other maxval (2 bytes per sample, most significant first, above 255) rescaled to 0-255
+	void scaledRgbToArgb(const unsigned char *rgb, uint32_t *argb, size_t count, size_t maxValue) {
+		size_t sampleBytes = maxValue > 255 ? 2 : 1;
+		for (size_t i = 0; i < count; i++) {
+			uint32_t channels[3];
+			for (size_t c = 0; c < 3; c++) {
+				const unsigned char *sample = rgb + (3 * i + c) * sampleBytes;
+				uint32_t value = sampleBytes == 2 ? (uint32_t(sample[0]) << 8) + sample[1] : sample[0];
+				channels[c] = (std::min<uint32_t>(value, maxValue) * 255 + maxValue / 2) / maxValue;
+			}
+			argb[i] = (255u << 24) + (channels[0] << 16) + (channels[1] << 8) + channels[2];
+		}
+	}
+}
+
+PpmHeader readPpmHeader(std::istream &inputStream, const std::string &filename) {
+	// Binary PPM: "P6", width, height and maxval, separated by whitespace and comments
+	if (inputStream.get() != 'P' || inputStream.get() != '6')
+		throw std::invalid_argument("`" + filename + "` is not a binary (P6) PPM");
+	PpmHeader header;
+	header.width = readHeaderValue(inputStream, filename, "width");
+	header.height = readHeaderValue(inputStream, filename, "height");
+	header.maxValue = readHeaderValue(inputStream, filename, "maxval");
+	if (header.maxValue == 0 || header.maxValue > 65535)
+		throw std::invalid_argument("`" + filename + "` has maxval " + std::to_string(header.maxValue) + ", expected 1-65535");
+	std::string size = std::to_string(header.width) + "x" + std::to_string(header.height);
+	if (header.width == 0 || header.height == 0)
+		throw std::invalid_argument("`" + filename + "` is " + size + ", expected at least 1x1");
+	// the payload's size in bytes has to fit in a size_t
+	if (header.width > std::numeric_limits<size_t>::max() / header.height / header.texelBytes())
+		throw std::invalid_argument("`" + filename + "` is " + size + ", too large to load");
+	// exactly one whitespace character separates the header from the pixels
+	if (!std::isspace(inputStream.get()))
+		throw std::invalid_argument("Failed to parse the header of `" + filename + "`");
+	return header;
+}
+
+size_t PpmHeader::texelBytes() const {
+	return maxValue > 255 ? 6 : 3;
+}
+
+void ppmToArgb(const unsigned char *payload, uint32_t *argb, size_t count, size_t maxValue) {
+	if (maxValue == 255) simdKernels().rgbToArgb(payload, argb, count);
+	else scaledRgbToArgb(payload, argb, count, maxValue);
+}
+
 TextureMap::TextureMap(const std::string &filename) {
 	std::ifstream inputStream(filename, std::ifstream::binary);
-	std::string nextLine;
-	// Get the "P6" magic number
-	std::getline(inputStream, nextLine);
-	// Read the width and height line
-	std::getline(inputStream, nextLine);
-	// Skip over any comment lines !
-	while (nextLine.at(0) == '#') std::getline(inputStream, nextLine);
-	auto widthAndHeight = split(nextLine, ' ');
-	if (widthAndHeight.size() != 2)
-		throw std::invalid_argument("Failed to parse width and height line, line was `" + nextLine + "`");
-
-	width = std::stoi(widthAndHeight[0]);
-	height = std::stoi(widthAndHeight[1]);
-	// Read the max value (which we assume is 255)
-	std::getline(inputStream, nextLine);
+	if (!inputStream) throw std::invalid_argument("Failed to open texture `" + filename + "`");
+	PpmHeader header = readPpmHeader(inputStream, filename);
+	width = header.width;
+	height = header.height;
 
+	// The payload is read in large blocks (a whole number of texels each) and converted straight into pixels
+	size_t texelBytes = header.texelBytes();
+	const size_t blockTexels = 64 * 1024;
+	std::vector<unsigned char> block(blockTexels * texelBytes);
 	pixels.resize(width * height);
-	for (size_t i = 0; i < width * height; i++) {
-		int red = inputStream.get();
-		int green = inputStream.get();
-		int blue = inputStream.get();
-		pixels[i] = ((255 << 24) + (red << 16) + (green << 8) + (blue));
+	for (size_t first = 0; first < pixels.size(); first += blockTexels) {
+		size_t count = std::min(blockTexels, pixels.size() - first);
+		if (!inputStream.read(reinterpret_cast<char *>(block.data()), count * texelBytes))
+			throw std::invalid_argument("`" + filename + "` ends after " + std::to_string(first + inputStream.gcount() / texelBytes) +
+			                            " of its " + std::to_string(pixels.size()) + " texels");
+		ppmToArgb(block.data(), pixels.data() + first, count, header.maxValue);
 	}
-	inputStream.close();
+	buildMipmaps();
+}
+
+void TextureMap::buildMipmaps() {
+	mipmaps.clear();
+	size_t sourceWidth = width;
+	size_t sourceHeight = height;
+	const std::vector<uint32_t> *source = &pixels;
+	while (sourceWidth > 1 || sourceHeight > 1) {
+		MipLevel level;
+		level.width = std::max<size_t>(1, sourceWidth / 2);
+		level.height = std::max<size_t>(1, sourceHeight / 2);
+		level.pixels.resize(level.width * level.height);
+		for (size_t y = 0; y < level.height; y++) {
+			for (size_t x = 0; x < level.width; x++) {
+				// average the 2x2 block below this texel, clamped for odd sizes and 1 pixel wide levels
+				size_t x0 = std::min(2 * x, sourceWidth - 1), x1 = std::min(2 * x + 1, sourceWidth - 1);
+				size_t y0 = std::min(2 * y, sourceHeight - 1), y1 = std::min(2 * y + 1, sourceHeight - 1);
+				uint32_t block[4] = {(*source)[x0 + y0 * sourceWidth], (*source)[x1 + y0 * sourceWidth],
+				                     (*source)[x0 + y1 * sourceWidth], (*source)[x1 + y1 * sourceWidth]};
+				uint32_t red = 0, green = 0, blue = 0;
+				for (uint32_t texel : block) {
+					red += (texel >> 16) & 0xFF;
+					green += (texel >> 8) & 0xFF;
+					blue += texel & 0xFF;
+				}
+				level.pixels[x + y * level.width] = (255 << 24) + ((red + 2) / 4 << 16) + ((green + 2) / 4 << 8) + (blue + 2) / 4;
+			}
+		}
+		mipmaps.push_back(std::move(level));
+		sourceWidth = mipmaps.back().width;
+		sourceHeight = mipmaps.back().height;
+		source = &mipmaps.back().pixels;
+	}
+}
+
+size_t TextureMap::levels() const {
+	return 1 + mipmaps.size();
 }
 
 std::ostream &operator<<(std::ostream &os, const TextureMap &map) {
@@ -5,13 +5,51 @@
 #include <stdexcept>
 #include "Utils.h"
 
+struct MipLevel {
+	size_t width;
+	size_t height;
+	std::vector<uint32_t> pixels;
+};
+
+struct PpmHeader {
+	size_t width;
+	size_t height;
+	size_t maxValue;
+	// 3 for 8 bit samples, 6 for 16 bit ones
+	size_t texelBytes() const;
+};
+
+// Reads a binary (P6) PPM header, leaving the stream at the first texel; throws std::invalid_argument, also for
+// a width or height of 0 or a payload too large to address
+PpmHeader readPpmHeader(std::istream &inputStream, const std::string &filename);
+// `count` texels of a P6 payload with the given maxval to opaque ARGB8888
+void ppmToArgb(const unsigned char *payload, uint32_t *argb, size_t count, size_t maxValue);
+
 class TextureMap {
 public:
 	size_t width;
 	size_t height;
 	std::vector<uint32_t> pixels;
+	// Box filtered copies, each half the size of the one before: mipmaps[0] is half of `pixels`, the last is 1x1
+	std::vector<MipLevel> mipmaps;
+	// Set by swizzleTexture (src/TextureSampler.h), after which every level is stored in 4x4 blocks instead of rows
+	bool swizzled = false;
+	// Set by compressTexture (src/TextureSampler.h), after which every level holds two words per 4x4 block of
+	// BC1 (DXT1) data instead of texels
+	bool compressed = false;
 
 	TextureMap();
+	// Loads a binary (P6) PPM with any maxval, throwing std::invalid_argument if it can't be read
 	TextureMap(const std::string &filename);
+	TextureMap(TextureMap &&) = default;
+	TextureMap &operator=(TextureMap &&) = default;
+	// Textures are shared through TextureHandle (see Resources.h), a copy of the pixels is never wanted
+	TextureMap(const TextureMap &) = delete;
+	TextureMap &operator=(const TextureMap &) = delete;
+	// Fills mipmaps from pixels (which must not be swizzled or compressed); the file constructor calls it, anything that edits
+	// pixels has to call it again
+	void buildMipmaps();
+	// Number of levels including the full size one
+	size_t levels() const;
 	friend std::ostream &operator<<(std::ostream &os, const TextureMap &point);
 };
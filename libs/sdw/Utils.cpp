@@ -3,14 +3,14 @@
 #include "Utils.h"
 
 std::vector<std::string> split(const std::string &line, char delimiter) {
-	auto haystack = line;
 	std::vector<std::string> tokens;
-	size_t pos;
-	while ((pos = haystack.find(delimiter)) != std::string::npos) {
-		tokens.push_back(haystack.substr(0, pos));
-		haystack.erase(0, pos + 1);
+	size_t start = 0, pos;
+	// scanned forward in place rather than erasing each token off the front of a copy
+	while ((pos = line.find(delimiter, start)) != std::string::npos) {
+		tokens.push_back(line.substr(start, pos - start));
+		start = pos + 1;
 	}
 	// Push the remaining chars onto the vector
-	tokens.push_back(haystack);
+	tokens.push_back(line.substr(start));
 	return tokens;
 }
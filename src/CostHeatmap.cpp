@@ -0,0 +1,57 @@
+#include "CostHeatmap.h"
+#include "Renderer.h"
+#include "TextOverlay.h"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+const char *heatmapMetricName(HeatmapMetric metric) {
+    static const char *names[HEATMAP_METRIC_COUNT] = {"off", "tests", "nodes", "time"};
+    return names[metric];
+}
+
+HeatmapMetric parseHeatmapMetric(const std::string &name) {
+    for (int metric = 0; metric < HEATMAP_METRIC_COUNT; metric++) {
+        if (name == heatmapMetricName(HeatmapMetric(metric))) return HeatmapMetric(metric);
+    }
+    throw std::invalid_argument("Unknown heatmap metric `" + name + "`, expected off, tests, nodes or time");
+}
+
+CostHeatmap::CostHeatmap(size_t width, size_t height) : width(width), height(height), costs(width * height, 0) {}
+
+void CostHeatmap::clear() {
+    std::fill(costs.begin(), costs.end(), 0);
+}
+
+uint32_t heatColour(float t) {
+    static const glm::vec3 ramp[] = {glm::vec3(0, 0, 0), glm::vec3(60, 0, 140), glm::vec3(200, 30, 80), glm::vec3(255, 150, 0), glm::vec3(255, 255, 210)};
+    const int stops = sizeof(ramp) / sizeof(ramp[0]);
+    t = std::min(std::max(t, 0.0f), 1.0f) * (stops - 1);
+    int i = std::min(int(t), stops - 2);
+    glm::vec3 c = ramp[i] + (ramp[i + 1] - ramp[i]) * (t - i);
+    return colouring(Colour(int(c.r), int(c.g), int(c.b)));
+}
+
+void CostHeatmap::draw(DrawingWindow &window) const {
+    std::vector<float> sorted(costs);
+    size_t rank = sorted.size() * 99 / 100;
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    float scale = sorted[rank] > 0 ? sorted[rank] : 1;
+
+    for (size_t y = 0; y < height && y < window.height; y++) {
+        for (size_t x = 0; x < width && x < window.width; x++) {
+            window.setPixelColour(x, y, heatColour(costs[y * width + x] / scale));
+        }
+    }
+
+    int barTop = int(window.height) - 22;
+    for (size_t x = 10; x + 10 < window.width; x++) {
+        uint32_t colour = heatColour(float(x - 10) / (window.width - 20));
+        for (int y = barTop; y < barTop + 6; y++) window.setPixelColour(x, y, colour);
+    }
+    char label[64];
+    uint32_t white = (255 << 24) + (255 << 16) + (255 << 8) + 255;
+    drawText(window, 10, barTop + 9, "0", white);
+    snprintf(label, sizeof(label), "%s per pixel, p99 %.4g", heatmapMetricName(metric), scale);
+    drawText(window, int(window.width) - 10 - int(strlen(label)) * (GLYPH_WIDTH + 1), barTop + 9, label, white);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <DrawingWindow.h>
+#include <string>
+#include <vector>
+
+// Debug view for the ray tracer that colours each pixel by how much work it took instead of by its shade
+enum HeatmapMetric {
+    HEATMAP_OFF,
+    HEATMAP_TESTS,  // ray-triangle tests (primary + shadow ray)
+    HEATMAP_NODES,  // acceleration structure nodes visited
+    HEATMAP_TIME,   // nanoseconds spent in rayTrace's per-pixel body
+    HEATMAP_METRIC_COUNT
+};
+
+class CostHeatmap {
+public:
+    HeatmapMetric metric = HEATMAP_OFF;
+
+    CostHeatmap(size_t width, size_t height);
+    bool enabled() const { return metric != HEATMAP_OFF; }
+    void record(size_t x, size_t y, float cost) { costs[y * width + x] = cost; }
+    void clear();
+    // Replaces the frame with the costs on a black -> purple -> orange -> white ramp (scaled to the 99th percentile
+    // so a few outliers don't flatten everything else) and a legend along the bottom
+    void draw(DrawingWindow &window) const;
+
+private:
+    size_t width;
+    size_t height;
+    std::vector<float> costs;
+};
+
+const char *heatmapMetricName(HeatmapMetric metric);
+// Throws std::invalid_argument for anything but off, tests, nodes or time
+HeatmapMetric parseHeatmapMetric(const std::string &name);
@@ -0,0 +1,70 @@
+#include "FrameArena.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+    std::atomic<uint64_t> allocationCount(0);
+}
+
+// Replacing the global operator new is the only way to see every allocation, including the ones made inside
+// std::vector and std::string. new[] and the nothrow versions forward to this one.
+void *operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    std::free(memory);
+}
+
+uint64_t heapAllocations() {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+FrameArena::FrameArena(size_t blockSize) : blockSize(blockSize) {}
+
+void *FrameArena::allocate(size_t bytes, size_t alignment) {
+    while (current < blocks.size()) {
+        Block &block = blocks[current];
+        size_t start = (reinterpret_cast<uintptr_t>(block.data.get()) + offset + alignment - 1) / alignment * alignment
+                       - reinterpret_cast<uintptr_t>(block.data.get());
+        if (start + bytes <= block.size) {
+            offset = start + bytes;
+            usedBytes += bytes;
+            return block.data.get() + start;
+        }
+        // doesn't fit: the rest of this block is wasted until the next reset
+        current++;
+        offset = 0;
+    }
+    size_t size = std::max(blockSize, bytes + alignment);
+    blocks.push_back({std::unique_ptr<char[]>(new char[size]), size});
+    return allocate(bytes, alignment);
+}
+
+void FrameArena::reset() {
+    current = 0;
+    offset = 0;
+    usedBytes = 0;
+}
+
+size_t FrameArena::used() const {
+    return usedBytes;
+}
+
+size_t FrameArena::capacity() const {
+    size_t total = 0;
+    for (const Block &block : blocks) total += block.size;
+    return total;
+}
+
+FrameArena &frameArena() {
+    thread_local FrameArena arena;
+    return arena;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for scratch memory that only has to live until the end of the frame. allocate() just moves a
+// pointer forward and reset() throws everything away at once. Blocks are kept across resets, so once the arena
+// has grown to fit a frame, later frames don't touch the heap at all.
+class FrameArena {
+public:
+    explicit FrameArena(size_t blockSize = 64 * 1024);
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+    // Default constructs `count` Ts. Destructors never run, so only trivially destructible types are allowed.
+    template <typename T>
+    T *allocate(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "FrameArena never runs destructors");
+        T *items = static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+        for (size_t i = 0; i < count; i++) new (items + i) T();
+        return items;
+    }
+    // Invalidates everything allocated since the last reset
+    void reset();
+    // Bytes handed out since the last reset
+    size_t used() const;
+    // Bytes held from the heap
+    size_t capacity() const;
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+    std::vector<Block> blocks;
+    size_t blockSize;
+    size_t current = 0;
+    size_t offset = 0;
+    size_t usedBytes = 0;
+};
+
+// The calling thread's arena. The viewer resets the main thread's arena after every frame and the benchmark
+// resets each worker's after every iteration.
+FrameArena &frameArena();
+
+// Lets standard containers take their storage from an arena; deallocate is a no-op
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+    FrameArena *arena;
+
+    ArenaAllocator(FrameArena &arena) : arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+    T *allocate(size_t count) { return static_cast<T *>(arena->allocate(count * sizeof(T), alignof(T))); }
+    void deallocate(T *, size_t) {}
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena == b.arena; }
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena != b.arena; }
+
+// e.g. ScratchVector<float> samples(frameArena());
+template <typename T>
+using ScratchVector = std::vector<T, ArenaAllocator<T>>;
+
+// Number of times the global operator new has been called by any thread since the program started
+uint64_t heapAllocations();
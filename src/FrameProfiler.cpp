@@ -0,0 +1,115 @@
+#include "FrameProfiler.h"
+#include "FrameArena.h"
+#include "TextOverlay.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+FrameProfiler profiler;
+
+const char *stageName(FrameStage stage) {
+    static const char *names[STAGE_COUNT] = {"load", "project", "raster", "primary", "shadow", "sleep", "present", "frame"};
+    return names[stage];
+}
+
+const char *counterName(FrameCounter counter) {
+    static const char *names[COUNTER_COUNT] = {"allocs", "arena_kb"};
+    return names[counter];
+}
+
+FrameProfiler::FrameProfiler() {
+    for (auto &total : current) total = 0;
+    for (auto &samples : history) samples.resize(PROFILER_HISTORY, 0);
+    for (auto &samples : counterHistory) samples.resize(PROFILER_HISTORY, 0);
+}
+
+void FrameProfiler::add(FrameStage stage, std::chrono::steady_clock::duration elapsed) {
+    current[stage].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(), std::memory_order_relaxed);
+}
+
+void FrameProfiler::endFrame() {
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        history[stage][frameCount % PROFILER_HISTORY] = current[stage].exchange(0) / 1e6f;
+    }
+    uint64_t allocations = heapAllocations();
+    counterHistory[COUNTER_HEAP_ALLOCS][frameCount % PROFILER_HISTORY] = float(allocations - allocationsAtFrameStart);
+    counterHistory[COUNTER_ARENA_KB][frameCount % PROFILER_HISTORY] = frameArena().used() / 1024.0f;
+    allocationsAtFrameStart = allocations;
+    frameCount++;
+}
+
+size_t FrameProfiler::frames() const {
+    return std::min<size_t>(frameCount, PROFILER_HISTORY);
+}
+
+double FrameProfiler::percentile(FrameStage stage, double p) const {
+    return percentile(history[stage], p);
+}
+
+double FrameProfiler::mean(FrameStage stage) const {
+    return mean(history[stage]);
+}
+
+double FrameProfiler::percentile(FrameCounter counter, double p) const {
+    return percentile(counterHistory[counter], p);
+}
+
+double FrameProfiler::mean(FrameCounter counter) const {
+    return mean(counterHistory[counter]);
+}
+
+double FrameProfiler::percentile(const std::vector<float> &series, double p) const {
+    if (frames() == 0) return 0;
+    // called several times a frame while the overlay is up, so the copy goes in the frame arena
+    ScratchVector<float> samples(series.begin(), series.begin() + frames(), frameArena());
+    size_t rank = std::min(samples.size() - 1, size_t(p * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    return samples[rank];
+}
+
+double FrameProfiler::mean(const std::vector<float> &series) const {
+    if (frames() == 0) return 0;
+    double total = 0;
+    for (size_t i = 0; i < frames(); i++) total += series[i];
+    return total / frames();
+}
+
+void FrameProfiler::drawOverlay(DrawingWindow &window) const {
+    int lineHeight = GLYPH_HEIGHT + 3;
+    char line[64];
+    snprintf(line, sizeof(line), "%-8s %7s %7s %7s ms", "stage", "p50", "p95", "p99");
+    darkenRect(window, 0, 0, 35 * (GLYPH_WIDTH + 1) + 8, overlayHeight());
+    int y = 4;
+    drawText(window, 4, y, line, (255 << 24) + (255 << 16) + (255 << 8) + 0);
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        FrameStage s = FrameStage(stage);
+        snprintf(line, sizeof(line), "%-8s %7.2f %7.2f %7.2f", stageName(s), percentile(s, 0.5), percentile(s, 0.95), percentile(s, 0.99));
+        y += lineHeight;
+        drawText(window, 4, y, line, (255 << 24) + (255 << 16) + (255 << 8) + 255);
+    }
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        FrameCounter c = FrameCounter(counter);
+        snprintf(line, sizeof(line), "%-8s %7.0f %7.0f %7.0f", counterName(c), percentile(c, 0.5), percentile(c, 0.95), percentile(c, 0.99));
+        y += lineHeight;
+        drawText(window, 4, y, line, (255 << 24) + (128 << 16) + (255 << 8) + 255);
+    }
+}
+
+int FrameProfiler::overlayHeight() const {
+    return (STAGE_COUNT + COUNTER_COUNT + 1) * (GLYPH_HEIGHT + 3) + 6;
+}
+
+void FrameProfiler::writeCsv(const std::string &filename) const {
+    std::ofstream csv(filename);
+    csv << "stage,p50_ms,p95_ms,p99_ms,mean_ms,frames\n";
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        FrameStage s = FrameStage(stage);
+        csv << stageName(s) << "," << percentile(s, 0.5) << "," << percentile(s, 0.95) << ","
+            << percentile(s, 0.99) << "," << mean(s) << "," << frames() << "\n";
+    }
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        FrameCounter c = FrameCounter(counter);
+        csv << counterName(c) << "," << percentile(c, 0.5) << "," << percentile(c, 0.95) << ","
+            << percentile(c, 0.99) << "," << mean(c) << "," << frames() << "\n";
+    }
+}
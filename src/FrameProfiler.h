@@ -0,0 +1,84 @@
+#pragma once
+
+#include <DrawingWindow.h>
+#include "TraceRecorder.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Stages of a frame that are timed separately. Stages hit by several threads (e.g. shadow rays when a frame is
+// split between threads) add up the time of every thread, so they can be longer than STAGE_FRAME.
+enum FrameStage {
+    STAGE_LOAD,       // OBJ reload / scene generation
+    STAGE_PROJECT,    // model -> canvas projection of every vertex
+    STAGE_RASTER,     // line drawing and triangle filling
+    STAGE_PRIMARY,    // camera rays
+    STAGE_SHADOW,     // shadow rays
+    STAGE_SLEEP,      // sleep_for at the end of each draw function
+    STAGE_PRESENT,    // DrawingWindow::renderFrame
+    STAGE_FRAME,      // the whole main loop iteration
+    STAGE_COUNT
+};
+
+// Per-frame counts tracked next to the stage times
+enum FrameCounter {
+    COUNTER_HEAP_ALLOCS,  // operator new calls during the frame, from any thread
+    COUNTER_ARENA_KB,     // scratch memory taken from the main thread's FrameArena
+    COUNTER_COUNT
+};
+
+#define PROFILER_HISTORY 240
+
+class FrameProfiler {
+public:
+    bool showOverlay = false;
+
+    FrameProfiler();
+    // Adds time to `stage` in the current frame, safe to call from several threads at once
+    void add(FrameStage stage, std::chrono::steady_clock::duration elapsed);
+    // Moves the current frame's totals into the rolling history and starts a new frame
+    void endFrame();
+    // p in [0, 1] over the last PROFILER_HISTORY frames, in milliseconds
+    double percentile(FrameStage stage, double p) const;
+    double mean(FrameStage stage) const;
+    // Same over the per-frame counts
+    double percentile(FrameCounter counter, double p) const;
+    double mean(FrameCounter counter) const;
+    size_t frames() const;
+    void drawOverlay(DrawingWindow &window) const;
+    // Height in pixels of what drawOverlay draws
+    int overlayHeight() const;
+    // One row per stage with p50/p95/p99/mean in milliseconds, then one per counter (in its own unit)
+    void writeCsv(const std::string &filename) const;
+
+private:
+    std::array<std::atomic<int64_t>, STAGE_COUNT> current;
+    std::array<std::vector<float>, STAGE_COUNT> history;
+    std::array<std::vector<float>, COUNTER_COUNT> counterHistory;
+    uint64_t allocationsAtFrameStart = 0;
+    size_t frameCount = 0;
+
+    double percentile(const std::vector<float> &series, double p) const;
+    double mean(const std::vector<float> &series) const;
+};
+
+const char *stageName(FrameStage stage);
+const char *counterName(FrameCounter counter);
+
+extern FrameProfiler profiler;
+
+// Adds the time between construction and destruction to a stage of the global profiler (and to the trace, if recording)
+class ScopedTimer {
+public:
+    explicit ScopedTimer(FrameStage stage) : stage(stage), trace(stageName(stage), "stage"), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() { profiler.add(stage, std::chrono::steady_clock::now() - start); }
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    FrameStage stage;
+    TraceScope trace;
+    std::chrono::steady_clock::time_point start;
+};
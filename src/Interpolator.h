@@ -0,0 +1,31 @@
+#pragma once
+
+// Yields `numberOfValues` evenly spaced values from `from` to `to` one at a time, replacing the helpers that
+// built a std::vector per call (interpolateSingleFloats & co). Works for float and the glm vector types.
+//
+//     for (Interpolator<float> x(0, 10, 5); !x.done(); ++x) use(*x);    // 0, 2.5, 5, 7.5, 10
+//
+// Values are accumulated like interpolateSingleFloats did, so reading past the end keeps extrapolating
+// instead of indexing out of bounds.
+template <typename T>
+class Interpolator {
+public:
+    Interpolator(T from, T to, int numberOfValues) :
+            value(from),
+            step((to - from) / float(numberOfValues - 1)),
+            remaining(numberOfValues) {}
+
+    const T &operator*() const { return value; }
+    const T *operator->() const { return &value; }
+    Interpolator &operator++() {
+        value += step;
+        remaining--;
+        return *this;
+    }
+    bool done() const { return remaining <= 0; }
+
+private:
+    T value;
+    T step;
+    int remaining;
+};
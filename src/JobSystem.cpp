@@ -0,0 +1,256 @@
+#include "JobSystem.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <exception>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+JobSystem jobs;
+
+struct Job {
+    std::function<void()> fn;
+    // unfinished jobs it runs after, plus one held by submit until they are all counted
+    std::atomic<int> pending{1};
+    std::atomic<bool> done{false};
+    std::exception_ptr error;
+    // guards `continuations` against the job finishing while submit adds one
+    std::mutex mutex;
+    std::vector<JobHandle> continuations;
+};
+
+namespace {
+    // The pool the calling thread belongs to, if any, and its queue in it
+    thread_local const JobSystem *currentSystem = nullptr;
+    thread_local size_t currentQueue = 0;
+
+    void pinToCpu(size_t cpu) {
+        size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu % cpus % CPU_SETSIZE, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(_WIN32)
+        SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << (cpu % cpus % (8 * sizeof(DWORD_PTR))));
+#else
+        (void) cpu, (void) cpus;
+#endif
+    }
+
+    struct ParallelFor {
+        size_t begin;
+        size_t end;
+        size_t grain;
+        size_t chunks;
+        const std::function<void(size_t, size_t)> *fn;
+        std::atomic<size_t> next{0};
+        std::mutex mutex;
+        std::exception_ptr error;
+
+        // Takes chunks until there are none left, so faster threads end up doing more of them
+        void run() {
+            for (size_t chunk; (chunk = next.fetch_add(1, std::memory_order_relaxed)) < chunks;) {
+                size_t first = begin + chunk * grain;
+                try {
+                    (*fn)(first, std::min(first + grain, end));
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!error) error = std::current_exception();
+                }
+            }
+        }
+    };
+}
+
+JobSystem::~JobSystem() {
+    stop();
+}
+
+void JobSystem::start(size_t threadCount, bool pinThreads) {
+    stop();
+    if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i <= threadCount; i++) queues.emplace_back(new Queue());
+    currentSystem = this;
+    currentQueue = 0;
+    if (pinThreads) pinToCpu(0);
+    for (size_t i = 1; i < threadCount; i++) workers.emplace_back([this, i, pinThreads]() { run(i, pinThreads); });
+}
+
+void JobSystem::stop() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers) worker.join();
+    workers.clear();
+    while (JobHandle job = pop()) execute(job);
+    queues.clear();
+    stopping = false;
+    if (currentSystem == this) currentSystem = nullptr;
+}
+
+JobHandle JobSystem::submit(std::function<void()> fn, std::initializer_list<JobHandle> after) {
+    JobHandle job = std::make_shared<Job>();
+    job->fn = std::move(fn);
+    for (const JobHandle &dependency : after) {
+        if (!dependency) continue;
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (dependency->done.load(std::memory_order_acquire)) continue;
+        job->pending.fetch_add(1, std::memory_order_relaxed);
+        dependency->continuations.push_back(job);
+    }
+    if (job->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) push(job);
+    return job;
+}
+
+void JobSystem::wait(const JobHandle &job) {
+    while (!job->done.load(std::memory_order_acquire)) {
+        if (JobHandle other = pop()) {
+            execute(other);
+            continue;
+        }
+        // Nothing to run: sleep like an idle worker until the job finishes or another is pushed. Counting itself
+        // as a waiter before checking `done` means execute either sees it and wakes it, or it sees the job done.
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers.fetch_add(1);
+        waiters.fetch_add(1);
+        wake.wait(lock, [this, &job]() { return job->done.load() || queued.load() > 0; });
+        waiters.fetch_sub(1);
+        sleepers.fetch_sub(1);
+    }
+    if (job->error) std::rethrow_exception(job->error);
+}
+
+void JobSystem::parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)> &fn) {
+    if (end <= begin) return;
+    grain = std::max<size_t>(grain, 1);
+    size_t chunks = (end - begin + grain - 1) / grain;
+    size_t helpers = std::min(chunks, threadCount()) - 1;
+    if (helpers == 0) {
+        for (size_t first = begin; first < end; first += grain) fn(first, std::min(first + grain, end));
+        return;
+    }
+
+    // the state lives on this stack frame, so every helper is waited for, even one that finds nothing left to do
+    ParallelFor state;
+    state.begin = begin;
+    state.end = end;
+    state.grain = grain;
+    state.chunks = chunks;
+    state.fn = &fn;
+    std::vector<JobHandle> helperJobs;
+    helperJobs.reserve(helpers);
+    for (size_t i = 0; i < helpers; i++) helperJobs.push_back(submit([&state]() { state.run(); }));
+    state.run();
+    for (const JobHandle &job : helperJobs) wait(job);
+    if (state.error) std::rethrow_exception(state.error);
+}
+
+void JobSystem::parallelForTiles(size_t width, size_t height, size_t tileSize, const std::function<void(size_t, size_t, size_t, size_t)> &fn) {
+    tileSize = std::max<size_t>(tileSize, 1);
+    size_t tilesX = (width + tileSize - 1) / tileSize;
+    size_t tilesY = (height + tileSize - 1) / tileSize;
+    parallelFor(0, tilesX * tilesY, 1, [&](size_t first, size_t last) {
+        for (size_t tile = first; tile < last; tile++) {
+            size_t x = tile % tilesX * tileSize, y = tile / tilesX * tileSize;
+            fn(x, y, std::min(x + tileSize, width), std::min(y + tileSize, height));
+        }
+    });
+}
+
+size_t JobSystem::queueIndex() const {
+    return currentSystem == this ? currentQueue : queues.size() - 1;
+}
+
+void JobSystem::push(JobHandle job) {
+    // without workers, jobs run as soon as they can
+    if (workers.empty()) {
+        execute(job);
+        return;
+    }
+    {
+        Queue &queue = *queues[queueIndex()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+    }
+    queued.fetch_add(1);
+    // a worker counts itself as a sleeper before checking `queued` one last time, so it either sees this job or
+    // is woken for it
+    if (sleepers.load() > 0) {
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wake.notify_one();
+    }
+}
+
+JobHandle JobSystem::pop() {
+    if (queued.load(std::memory_order_acquire) == 0) return nullptr;
+    size_t own = queueIndex();
+    {
+        Queue &queue = *queues[own];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            JobHandle job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+            queued.fetch_sub(1);
+            return job;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); i++) {
+        Queue &victim = *queues[(own + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.jobs.empty()) continue;
+        JobHandle job = std::move(victim.jobs.front());
+        victim.jobs.pop_front();
+        queued.fetch_sub(1);
+        return job;
+    }
+    return nullptr;
+}
+
+void JobSystem::execute(const JobHandle &job) {
+    try {
+        job->fn();
+    } catch (...) {
+        job->error = std::current_exception();
+    }
+    // let go of whatever the job captured before anyone waiting on it carries on
+    job->fn = nullptr;
+    std::vector<JobHandle> continuations;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->done.store(true);
+        continuations.swap(job->continuations);
+    }
+    // workers sleep on the same condition variable, so wake them all for the waiter to be among them
+    if (waiters.load() > 0) {
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wake.notify_all();
+    }
+    for (JobHandle &continuation : continuations) {
+        if (continuation->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) push(std::move(continuation));
+    }
+}
+
+void JobSystem::run(size_t index, bool pinThreads) {
+    currentSystem = this;
+    currentQueue = index;
+    if (pinThreads) pinToCpu(index);
+    tracer.setThreadName("job worker " + std::to_string(index));
+    while (true) {
+        if (JobHandle job = pop()) {
+            execute(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers.fetch_add(1);
+        wake.wait(lock, [this]() { return stopping || queued.load() > 0; });
+        sleepers.fetch_sub(1);
+        if (stopping) return;
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The one thread pool everything parallel runs on: ray traced tiles, rasterised bands of rows, the OBJ loader's
+// chunks of lines, texture and virtual texture page loads and the viewer's image writers. Every thread has its own
+// deque of jobs, pushing and popping at the back; a thread whose deque is empty steals from the front of another's.
+// A thread waiting for a job runs other jobs in the meantime, so jobs can wait on jobs (e.g. a parallelFor inside a
+// parallelFor). Until start() is called, and with a single thread, everything runs inline on the calling thread.
+//
+// A job can run on any thread, including one that is waiting in the middle of another job, so jobs mustn't use the
+// frame arena (nothing resets a worker's) or hold a lock while waiting that another job could want.
+
+struct Job;
+using JobHandle = std::shared_ptr<Job>;
+
+class JobSystem {
+public:
+    JobSystem() = default;
+    ~JobSystem();
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    // Starts threadCount - 1 workers, the calling thread being the last one; 0 means one per hardware thread.
+    // With pinThreads, thread i is kept on CPU i (Linux and Windows, ignored elsewhere). main calls it once.
+    void start(size_t threadCount = 0, bool pinThreads = false);
+    // Joins the workers, then runs whatever they left queued on the calling thread
+    void stop();
+    // Including the thread that called start(), so 1 until then
+    size_t threadCount() const { return workers.size() + 1; }
+
+    // Runs fn on some thread once every job in `after` has finished, whether or not they threw
+    JobHandle submit(std::function<void()> fn, std::initializer_list<JobHandle> after = {});
+    // Runs other jobs until `job` has finished, sleeping while there are none, then rethrows anything it threw
+    void wait(const JobHandle &job);
+
+    // fn(first, last) for chunks of at most `grain` items covering [begin, end), returning once every chunk is
+    // done. The calling thread takes chunks too. Rethrows an exception one of them threw.
+    void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)> &fn);
+    // fn(x, y, lastX, lastY) for every tileSize x tileSize tile of a width x height image, [x, lastX) by
+    // [y, lastY), the ones on the right and bottom edges cut short. Tiles are taken left to right, top to bottom.
+    void parallelForTiles(size_t width, size_t height, size_t tileSize, const std::function<void(size_t, size_t, size_t, size_t)> &fn);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+
+    size_t queueIndex() const;
+    void push(JobHandle job);
+    // The back of the calling thread's deque, or else the front of the first other one with anything in it
+    JobHandle pop();
+    void execute(const JobHandle &job);
+    void run(size_t index, bool pinThreads);
+
+    // One per thread, plus a last one shared by threads outside the pool
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> sleepers{0};
+    // threads in wait() with nothing to run, also counted in sleepers
+    std::atomic<size_t> waiters{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+extern JobSystem jobs;
@@ -0,0 +1,36 @@
+#include "Mesh.h"
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+    struct PositionKey {
+        uint32_t bits[3];
+        bool operator==(const PositionKey &other) const {
+            return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+        }
+    };
+
+    struct PositionHash {
+        size_t operator()(const PositionKey &key) const {
+            return (size_t(key.bits[0]) * 73856093) ^ (size_t(key.bits[1]) * 19349663) ^ (size_t(key.bits[2]) * 83492791);
+        }
+    };
+}
+
+Mesh buildMesh(std::vector<ModelTriangle> triangles) {
+    Mesh mesh;
+    mesh.triangles = std::move(triangles);
+    mesh.indices.reserve(3 * mesh.triangles.size());
+
+    std::unordered_map<PositionKey, uint32_t, PositionHash> seen;
+    for (const ModelTriangle &triangle : mesh.triangles) {
+        for (const glm::vec3 &vertex : triangle.vertices) {
+            PositionKey key;
+            std::memcpy(key.bits, &vertex[0], sizeof(key.bits));
+            auto inserted = seen.emplace(key, uint32_t(mesh.positions.size()));
+            if (inserted.second) mesh.positions.emplace_back(vertex, 1.0f);
+            mesh.indices.push_back(inserted.first->second);
+        }
+    }
+    return mesh;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "TextureCache.h"
+#include "VirtualTexture.h"
+#include <ModelTriangle.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// A triangle list plus an indexed copy of its vertices, so the vertex stage can project every distinct
+// vertex once per frame instead of three times per triangle (the cornell box shares each vertex ~5 ways).
+struct Mesh {
+    std::vector<ModelTriangle> triangles;
+    // w is always 1; four floats per vertex let the vertex stage load a whole vertex with one SSE load
+    std::vector<glm::vec4> positions;
+    // three per triangle, triangle i uses positions[indices[3 * i + k]]
+    std::vector<uint32_t> indices;
+    // map_Kd textures of the mesh's materials, which load in the background (see TextureCache.h), the .vt ones
+    // (see VirtualTexture.h) and per triangle an index into textures, continuing into virtualTextures, or -1 for a
+    // flat colour. All are empty when nothing is textured. Textured triangles take their uvs from texturePoints.
+    std::vector<TextureRef> textures;
+    std::vector<VirtualTextureHandle> virtualTextures;
+    std::vector<int> triangleTextures;
+
+    Mesh() = default;
+    Mesh(Mesh &&) = default;
+    Mesh &operator=(Mesh &&) = default;
+    // Meshes are shared through MeshHandle (see Resources.h), copying a whole scene is never wanted
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+
+    // Index of triangle i's texture (see triangleTextures), or -1 if it has a flat colour
+    int textureIndex(size_t i) const {
+        return triangleTextures.empty() ? -1 : triangleTextures[i];
+    }
+};
+
+// Indexes an unindexed triangle list by merging vertices with bit-identical positions
+Mesh buildMesh(std::vector<ModelTriangle> triangles);
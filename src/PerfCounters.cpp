@@ -0,0 +1,98 @@
+#include "PerfCounters.h"
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char *perfCounterName(PerfCounter counter) {
+    static const char *names[PERF_COUNTER_COUNT] = {"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"};
+    return names[counter];
+}
+
+#ifdef __linux__
+
+static int openCounter(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // the kernel multiplexes counters when there are too few hardware slots, these let us scale the result back up
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+PerfCounters::PerfCounters() {
+    const uint64_t l1dReadMiss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    fds[PERF_CYCLES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fds[PERF_INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[PERF_L1D_MISSES] = openCounter(PERF_TYPE_HW_CACHE, l1dReadMiss);
+    fds[PERF_LLC_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fds[PERF_BRANCH_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    if (!available()) {
+        errorMessage = std::string("perf_event_open failed: ") + std::strerror(errno) + " (check /proc/sys/kernel/perf_event_paranoid)";
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int fd : fds) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+void PerfCounters::start() {
+    for (int fd : fds) {
+        if (fd < 0) continue;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+PerfSample PerfCounters::stop() {
+    PerfSample sample;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (fds[i] < 0) continue;
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t data[3]; // value, time enabled, time running
+        if (read(fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) continue;
+        sample.values[i] = data[2] < data[1] ? uint64_t(double(data[0]) * data[1] / data[2]) : data[0];
+        sample.valid[i] = true;
+    }
+    return sample;
+}
+
+#else
+
+PerfCounters::PerfCounters() : errorMessage("hardware counters are only supported on Linux") {
+    fds.fill(-1);
+}
+
+PerfCounters::~PerfCounters() = default;
+
+void PerfCounters::start() {}
+
+PerfSample PerfCounters::stop() {
+    return PerfSample();
+}
+
+#endif
+
+bool PerfCounters::available() const {
+    for (int fd : fds) {
+        if (fd >= 0) return true;
+    }
+    return false;
+}
+
+const std::string &PerfCounters::error() const {
+    return errorMessage;
+}
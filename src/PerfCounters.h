@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+// Hardware counters through Linux perf_event_open. Every counter is opened on its own, so a machine (or VM, or
+// container) that only exposes some of them still reports those. Counters that couldn't be opened read as
+// unavailable, and on other platforms nothing is ever available.
+enum PerfCounter {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTER_COUNT
+};
+
+struct PerfSample {
+    std::array<uint64_t, PERF_COUNTER_COUNT> values{};
+    std::array<bool, PERF_COUNTER_COUNT> valid{};
+};
+
+class PerfCounters {
+public:
+    // Counts the calling thread plus every thread it creates afterwards, still running or not, summed on each read
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    bool available() const;
+    // Why nothing could be opened, empty if at least one counter works
+    const std::string &error() const;
+    void start();
+    PerfSample stop();
+
+private:
+    std::array<int, PERF_COUNTER_COUNT> fds;
+    std::string errorMessage;
+};
+
+const char *perfCounterName(PerfCounter counter);
@@ -0,0 +1,101 @@
+#include "RayStats.h"
+#include "TextOverlay.h"
+#include <cstdio>
+
+RayStatsCollector rayStats;
+
+RayStats &RayStats::operator+=(const RayStats &other) {
+    primaryRays += other.primaryRays;
+    shadowRays += other.shadowRays;
+    triangleTests += other.triangleTests;
+    hits += other.hits;
+    nodesVisited += other.nodesVisited;
+    return *this;
+}
+
+uint64_t RayStats::rays() const {
+    return primaryRays + shadowRays;
+}
+
+double RayStats::testsPerRay() const {
+    return rays() ? double(triangleTests) / rays() : 0;
+}
+
+double RayStats::nodesPerRay() const {
+    return rays() ? double(nodesVisited) / rays() : 0;
+}
+
+double RayStats::hitRate() const {
+    return rays() ? double(hits) / rays() : 0;
+}
+
+RayStats &threadRayStats() {
+    thread_local RayStats stats;
+    return stats;
+}
+
+void RayStatsCollector::mergeThread() {
+    RayStats &local = threadRayStats();
+    std::lock_guard<std::mutex> lock(mutex);
+    current += local;
+    local = RayStats();
+}
+
+void RayStatsCollector::endFrame(double seconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (current.rays() == 0) return;
+    last = current;
+    lastSeconds = seconds;
+    cumulative += current;
+    totalSeconds += seconds;
+    current = RayStats();
+}
+
+void RayStatsCollector::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    current = last = cumulative = RayStats();
+    lastSeconds = totalSeconds = 0;
+}
+
+RayStats RayStatsCollector::lastFrame() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return last;
+}
+
+RayStats RayStatsCollector::total() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return cumulative;
+}
+
+double RayStatsCollector::lastFrameRaysPerSecond() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lastSeconds > 0 ? last.rays() / lastSeconds : 0;
+}
+
+double RayStatsCollector::totalRaysPerSecond() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return totalSeconds > 0 ? cumulative.rays() / totalSeconds : 0;
+}
+
+void RayStatsCollector::drawOverlay(DrawingWindow &window, int y) const {
+    RayStats frame = lastFrame();
+    RayStats all = total();
+    int lineHeight = GLYPH_HEIGHT + 3;
+    uint32_t white = (255 << 24) + (255 << 16) + (255 << 8) + 255;
+    char line[64];
+    darkenRect(window, 0, y - 4, 35 * (GLYPH_WIDTH + 1) + 8, 7 * lineHeight + 6);
+    snprintf(line, sizeof(line), "%-10s %11s %11s", "rays", "frame", "total");
+    drawText(window, 4, y, line, (255 << 24) + (255 << 16) + (255 << 8) + 0);
+    snprintf(line, sizeof(line), "%-10s %11.3g %11.3g", "rays/s", lastFrameRaysPerSecond(), totalRaysPerSecond());
+    drawText(window, 4, y += lineHeight, line, white);
+    snprintf(line, sizeof(line), "%-10s %11llu %11llu", "primary", (unsigned long long) frame.primaryRays, (unsigned long long) all.primaryRays);
+    drawText(window, 4, y += lineHeight, line, white);
+    snprintf(line, sizeof(line), "%-10s %11llu %11llu", "shadow", (unsigned long long) frame.shadowRays, (unsigned long long) all.shadowRays);
+    drawText(window, 4, y += lineHeight, line, white);
+    snprintf(line, sizeof(line), "%-10s %11.1f %11.1f", "tests/ray", frame.testsPerRay(), all.testsPerRay());
+    drawText(window, 4, y += lineHeight, line, white);
+    snprintf(line, sizeof(line), "%-10s %11.1f %11.1f", "nodes/ray", frame.nodesPerRay(), all.nodesPerRay());
+    drawText(window, 4, y += lineHeight, line, white);
+    snprintf(line, sizeof(line), "%-10s %10.1f%% %10.1f%%", "hits", 100 * frame.hitRate(), 100 * all.hitRate());
+    drawText(window, 4, y += lineHeight, line, white);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <DrawingWindow.h>
+#include <cstdint>
+#include <mutex>
+
+struct RayStats {
+    uint64_t primaryRays = 0;
+    uint64_t shadowRays = 0;
+    uint64_t triangleTests = 0;
+    uint64_t hits = 0;
+    // acceleration structure nodes visited; the brute force loop in getClosestIntersection has no nodes, so it stays 0
+    uint64_t nodesVisited = 0;
+
+    RayStats &operator+=(const RayStats &other);
+    uint64_t rays() const;
+    double testsPerRay() const;
+    double nodesPerRay() const;
+    double hitRate() const;
+};
+
+// Counters of the calling thread, cheap enough to bump from the intersection loop
+RayStats &threadRayStats();
+
+// Per-thread counters are merged into the current frame, frames are added up into a running total
+class RayStatsCollector {
+public:
+    // Adds the calling thread's counters to the current frame and zeroes them
+    void mergeThread();
+    // Closes the current frame; frames without any rays (e.g. rasterised ones) are ignored
+    void endFrame(double seconds);
+    void reset();
+    RayStats lastFrame() const;
+    RayStats total() const;
+    double lastFrameRaysPerSecond() const;
+    double totalRaysPerSecond() const;
+    // Frame and cumulative counters as text, drawn below the profiler overlay
+    void drawOverlay(DrawingWindow &window, int y) const;
+
+private:
+    mutable std::mutex mutex;
+    RayStats current;
+    RayStats last;
+    RayStats cumulative;
+    double lastSeconds = 0;
+    double totalSeconds = 0;
+};
+
+extern RayStatsCollector rayStats;
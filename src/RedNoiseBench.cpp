@@ -0,0 +1,568 @@
+#include <Renderer.h>
+#include <CostHeatmap.h>
+#include <FrameArena.h>
+#include <JobSystem.h>
+#include <PerfCounters.h>
+#include <RayStats.h>
+#include <Resources.h>
+#include <Sampling.h>
+#include <SceneGenerator.h>
+#include <TextureSampler.h>
+#include <TraceRecorder.h>
+#include <VertexStage.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+// Micro and macro benchmarks for the renderer hot paths.
+//
+//   RedNoiseBench [--scene SPEC]... [--threads N] [--pin-threads] [--iterations N] [--filter NAME] [--json FILE]
+//                 [--trace FILE] [--perf] [--heatmap tests|nodes|time] [--simd sse2|avx2|avx512]
+//
+// --scene      scene to run the suite on, see generateScene (e.g. sphere:1e5); repeat it to sweep scene sizes
+// --threads    threads in the job system, which splits up every macro benchmark's frame (and the OBJ loader's
+//              parsing); micro benchmarks run one copy per thread
+// --pin-threads keep each of the job system's threads on its own CPU
+// --iterations timed repetitions of every benchmark (after one warm-up run)
+// --filter     only run benchmarks whose name contains this string
+// --json       write the JSON report to a file instead of stdout
+// --trace      record every benchmark iteration and worker thread as Chrome trace-event JSON (open in Perfetto)
+// --perf       add hardware counters (cycles, instructions, cache and branch misses) per iteration, Linux only
+// --heatmap    also ray trace each scene once more and save its per-pixel cost as heatmap_<n>.ppm
+// --simd       run the SIMD kernels built for this instruction set instead of the best one the CPU supports
+
+// Results of the micro benchmarks are added here so the compiler can't drop the calls
+std::atomic<size_t> benchSink(0);
+
+struct BenchmarkOptions {
+    std::vector<std::string> scenes;
+    int threads = 1;
+    bool pinThreads = false;
+    int iterations = 5;
+    std::string filter;
+    std::string jsonPath;
+    std::string tracePath;
+    bool usePerf = false;
+    HeatmapMetric heatmapMetric = HEATMAP_OFF;
+    // opened in main for --perf, stays null when no hardware counter is available
+    PerfCounters *perf = nullptr;
+};
+
+struct BenchmarkResult {
+    std::string name;
+    std::string kind;
+    int iterations;
+    size_t itemsPerIteration;
+    double minNs;
+    double medianNs;
+    double meanNs;
+    double maxNs;
+    // extra per-benchmark numbers, e.g. ray statistics for anything that traces rays
+    std::vector<std::pair<std::string, double>> counters;
+};
+
+struct BenchmarkRun {
+    std::string scene;
+    size_t triangles;
+    std::vector<BenchmarkResult> results;
+};
+
+// Micro benchmarks call fn once per thread with (threadIndex, threadCount), the wall clock time of all threads being
+// one sample; macro benchmarks call it once with (0, 1) and leave the threads to the job system
+BenchmarkResult measure(const std::string &name, const std::string &kind, size_t itemsPerIteration,
+                        const BenchmarkOptions &options, const std::function<void(int, int)> &fn) {
+    auto runOnce = [&]() {
+        TraceScope trace(tracer.intern(name), "benchmark");
+        if (options.threads <= 1 || kind == "macro") {
+            fn(0, 1);
+            frameArena().reset();
+            return;
+        }
+        std::vector<std::thread> workers;
+        for (int t = 0; t < options.threads; t++) {
+            workers.emplace_back([&fn, &options, t]() {
+                tracer.setThreadName("worker " + std::to_string(t));
+                TraceScope trace("work", "worker");
+                fn(t, options.threads);
+                frameArena().reset();
+            });
+        }
+        for (auto &worker : workers) worker.join();
+    };
+
+    rayStats.reset();
+    runOnce(); // warm up caches and the file system
+    std::vector<double> samples;
+    samples.reserve(options.iterations);
+    PerfSample perfTotal;
+    uint64_t allocationsBefore = heapAllocations();
+    for (int i = 0; i < options.iterations; i++) {
+        if (options.perf) options.perf->start();
+        auto start = std::chrono::steady_clock::now();
+        runOnce();
+        auto end = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+        if (options.perf) {
+            PerfSample sample = options.perf->stop();
+            for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+                perfTotal.values[c] += sample.values[c];
+                perfTotal.valid[c] = sample.valid[c];
+            }
+        }
+    }
+    // includes the std::thread spawns and the job system's jobs when --threads is above 1
+    double allocationsPerIteration = double(heapAllocations() - allocationsBefore) / options.iterations;
+    std::sort(samples.begin(), samples.end());
+    // the warm-up run is counted too, and threads that never reached rayTraceTile still hold their counters
+    rayStats.mergeThread();
+    rayStats.endFrame(1);
+    RayStats rays = rayStats.total();
+
+    double total = 0;
+    for (double sample : samples) total += sample;
+    BenchmarkResult result;
+    result.name = name;
+    result.kind = kind;
+    result.iterations = options.iterations;
+    result.itemsPerIteration = itemsPerIteration;
+    result.minNs = samples.front();
+    result.medianNs = samples[samples.size() / 2];
+    result.meanNs = total / samples.size();
+    result.maxNs = samples.back();
+    result.counters.emplace_back("heap_allocations_per_iteration", allocationsPerIteration);
+    if (rays.rays() > 0) {
+        double perIteration = 1.0 / (options.iterations + 1);
+        result.counters.emplace_back("rays_per_iteration", rays.rays() * perIteration);
+        result.counters.emplace_back("rays_per_second", rays.rays() * perIteration / (result.medianNs * 1e-9));
+        result.counters.emplace_back("triangle_tests_per_iteration", rays.triangleTests * perIteration);
+        result.counters.emplace_back("tests_per_ray", rays.testsPerRay());
+        result.counters.emplace_back("nodes_per_ray", rays.nodesPerRay());
+        result.counters.emplace_back("hit_rate", rays.hitRate());
+    }
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (!perfTotal.valid[c]) continue;
+        result.counters.emplace_back(std::string(perfCounterName(PerfCounter(c))) + "_per_iteration", double(perfTotal.values[c]) / options.iterations);
+    }
+    if (perfTotal.valid[PERF_CYCLES] && perfTotal.valid[PERF_INSTRUCTIONS] && perfTotal.values[PERF_CYCLES] > 0) {
+        result.counters.emplace_back("ipc", double(perfTotal.values[PERF_INSTRUCTIONS]) / perfTotal.values[PERF_CYCLES]);
+    }
+    std::cerr << name << ": " << result.medianNs / 1e6 << " ms (median of " << samples.size() << ")" << std::endl;
+    return result;
+}
+
+void writeJson(std::ostream &os, const BenchmarkOptions &options, const std::vector<BenchmarkRun> &runs) {
+    os.precision(12);
+    os << "{\n";
+    os << "  \"timestamp\": " << std::time(nullptr) << ",\n";
+    os << "  \"width\": " << WIDTH << ",\n";
+    os << "  \"height\": " << HEIGHT << ",\n";
+    os << "  \"threads\": " << options.threads << ",\n";
+    os << "  \"simd\": \"" << simdLevelName(simdLevel()) << "\",\n";
+    os << "  \"runs\": [\n";
+    for (size_t run = 0; run < runs.size(); run++) {
+        const std::vector<BenchmarkResult> &results = runs[run].results;
+        os << "    {\n";
+        os << "      \"scene\": \"" << runs[run].scene << "\",\n";
+        os << "      \"triangles\": " << runs[run].triangles << ",\n";
+        os << "      \"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchmarkResult &r = results[i];
+            os << "        {\"name\": \"" << r.name << "\", \"kind\": \"" << r.kind << "\""
+               << ", \"iterations\": " << r.iterations
+               << ", \"items_per_iteration\": " << r.itemsPerIteration
+               << ", \"min_ns\": " << r.minNs
+               << ", \"median_ns\": " << r.medianNs
+               << ", \"mean_ns\": " << r.meanNs
+               << ", \"max_ns\": " << r.maxNs;
+            for (size_t c = 0; c < r.counters.size(); c++) {
+                os << (c == 0 ? ", \"counters\": {" : ", ") << "\"" << r.counters[c].first << "\": " << r.counters[c].second;
+            }
+            os << (r.counters.empty() ? "}" : "}}")
+               << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        os << "      ]\n";
+        os << "    }" << (run + 1 < runs.size() ? ",\n" : "\n");
+    }
+    os << "  ]\n";
+    os << "}\n";
+}
+
+BenchmarkOptions parseOptions(int argc, char *argv[]) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--perf") {
+            options.usePerf = true;
+            continue;
+        }
+        if (arg == "--pin-threads") {
+            options.pinThreads = true;
+            continue;
+        }
+        if (i + 1 >= argc) printMessageAndQuit("Missing value for", argv[i]);
+        if (arg == "--scene") options.scenes.push_back(argv[++i]);
+        else if (arg == "--threads") options.threads = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--iterations") options.iterations = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--filter") options.filter = argv[++i];
+        else if (arg == "--json") options.jsonPath = argv[++i];
+        else if (arg == "--trace") options.tracePath = argv[++i];
+        else if (arg == "--heatmap") options.heatmapMetric = parseHeatmapMetric(argv[++i]);
+        else if (arg == "--simd") setSimdLevel(parseSimdLevel(argv[++i]));
+        else printMessageAndQuit("Unknown option", argv[i]);
+    }
+    if (options.scenes.empty()) options.scenes.push_back("cornell-box.obj");
+    return options;
+}
+
+// One round of everything the job system promises, returning how many of the checks failed: nested parallelFor,
+// tiles covering the image exactly once, a diamond of dependencies running in order, exceptions reaching the
+// waiter, and a parallelFor from a thread outside the pool. With --threads above 1 it doubles as a stress test,
+// e.g. under -fsanitize=thread.
+int jobSystemRound() {
+    int failures = 0;
+    std::atomic<uint64_t> sum(0);
+    jobs.parallelFor(0, 1000, 7, [&](size_t first, size_t last) {
+        jobs.parallelFor(first * 10, last * 10, 3, [&](size_t innerFirst, size_t innerLast) {
+            for (size_t i = innerFirst; i < innerLast; i++) sum.fetch_add(i, std::memory_order_relaxed);
+        });
+    });
+    failures += sum != 9999ull * 10000 / 2;
+
+    const size_t width = 37, height = 29;
+    std::vector<std::atomic<int>> hits(width * height);
+    for (std::atomic<int> &hit : hits) hit = 0;
+    jobs.parallelForTiles(width, height, 8, [&](size_t x, size_t y, size_t lastX, size_t lastY) {
+        for (size_t row = y; row < lastY; row++) {
+            for (size_t column = x; column < lastX; column++) hits[row * width + column]++;
+        }
+    });
+    failures += std::any_of(hits.begin(), hits.end(), [](const std::atomic<int> &hit) { return hit != 1; });
+
+    std::atomic<int> step(0);
+    int order[4] = {-1, -1, -1, -1};
+    JobHandle top = jobs.submit([&]() { order[0] = step++; });
+    JobHandle left = jobs.submit([&]() { order[1] = step++; }, {top});
+    JobHandle right = jobs.submit([&]() { order[2] = step++; }, {top});
+    JobHandle bottom = jobs.submit([&]() { order[3] = step++; }, {left, right});
+    jobs.wait(bottom);
+    failures += !(order[0] == 0 && order[1] > 0 && order[2] > 0 && order[3] == 3);
+
+    bool caught = false;
+    try {
+        jobs.parallelFor(0, 100, 1, [](size_t first, size_t) {
+            if (first == 57) throw std::runtime_error("parallelFor");
+        });
+    } catch (const std::runtime_error &) {
+        caught = true;
+    }
+    failures += !caught;
+    caught = false;
+    JobHandle throwing = jobs.submit([]() { throw std::runtime_error("submit"); });
+    try {
+        jobs.wait(throwing);
+    } catch (const std::runtime_error &) {
+        caught = true;
+    }
+    failures += !caught;
+
+    std::atomic<uint64_t> outsideSum(0);
+    std::thread outside([&]() {
+        jobs.parallelFor(0, 500, 5, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++) outsideSum.fetch_add(i, std::memory_order_relaxed);
+        });
+    });
+    outside.join();
+    failures += outsideSum != 499ull * 500 / 2;
+    return failures;
+}
+
+BenchmarkRun runSuite(const std::string &spec, const BenchmarkOptions &options) {
+    MeshHandle mesh = loadSceneMesh(spec);
+    // textured scenes: draw once so the textures are queued, and time them rather than the placeholder
+    if (!mesh->textures.empty()) {
+        for (const TextureRef &slot : mesh->textures) slot->get();
+        waitForTextures();
+    }
+    const std::vector<ModelTriangle> &scene = mesh->triangles;
+    if (scene.empty()) printMessageAndQuit("Could not load scene (run from the project root):", spec.c_str());
+    std::cerr << spec << " (" << scene.size() << " triangles)" << std::endl;
+
+    // Every thread draws into its own offscreen window with its own context (camera, light and depth buffer), all
+    // starting from the viewer's defaults
+    std::vector<DrawingWindow> windows;
+    std::vector<RenderContext> contexts(options.threads);
+    for (int t = 0; t < options.threads; t++) windows.emplace_back(WIDTH, HEIGHT);
+
+    BenchmarkRun benchmarkRun;
+    benchmarkRun.scene = spec;
+    benchmarkRun.triangles = scene.size();
+    std::vector<BenchmarkResult> &results = benchmarkRun.results;
+    auto run = [&](const std::string &name, const std::string &kind, size_t items, const std::function<void(int, int)> &fn) {
+        if (name.find(options.filter) == std::string::npos) return;
+        results.push_back(measure(name, kind, items, options, fn));
+    };
+
+    const int calls = 10000;
+    run("split", "micro", calls, [&](int t, int n) {
+        std::string vertexLine = "v -0.884011 2.129257 -0.991281";
+        size_t tokens = 0;
+        for (int i = 0; i < calls; i++) tokens += split(vertexLine, ' ').size();
+        benchSink.fetch_add(tokens, std::memory_order_relaxed);
+    });
+
+    // generated scenes go through the OBJ loader too, so its cost is measured at every scene size
+    std::string objPath = spec.find(':') == std::string::npos ? spec : "bench_scene.obj";
+    if (objPath != spec) writeObjFile(objPath, "bench_scene.mtl", scene, 0.35);
+    run("readObjFile", "micro", scene.size(), [&](int t, int n) {
+        readObjFile(objPath, 0.35);
+    });
+    if (objPath != spec) {
+        std::remove(objPath.c_str());
+        std::remove("bench_scene.mtl");
+    }
+
+    run("interpolate", "micro", calls, [&](int t, int n) {
+        float sum = 0;
+        for (int i = 0; i < calls; i++) {
+            for (Interpolator<float> value(0, WIDTH, HEIGHT); !value.done(); ++value) sum += *value;
+        }
+        benchSink.fetch_add(size_t(sum), std::memory_order_relaxed);
+    });
+
+    const int triangles = 100;
+    CanvasTriangle benchTriangle(CanvasPoint(320, 40, 2.0), CanvasPoint(560, 420, 3.0), CanvasPoint(80, 300, 4.0));
+    run("filledTriangle", "micro", triangles, [&](int t, int n) {
+        for (int i = 0; i < triangles; i++) filledTriangle(windows[t], benchTriangle, Colour(0, 255, 0), contexts[t].depth);
+    });
+
+    // the same triangle through every raster kernel, with texture.ppm on it and its brightness fading out; fewer
+    // of them, since sampling makes the textured kernels ~30x slower
+    const int kernelTriangles = 10;
+    CanvasTriangle kernelTriangle = benchTriangle;
+    const float uvs[3][2] = {{0, 0}, {1, 0.5f}, {0, 1}}, brightness[3] = {1, 0.6f, 0.2f};
+    for (int k = 0; k < 3; k++) {
+        kernelTriangle[k].texturePoint = TexturePoint(uvs[k][0], uvs[k][1]);
+        kernelTriangle[k].brightness = brightness[k];
+    }
+    TextureHandle kernelTexture = loadTexture("texture.ppm");
+    for (unsigned features = 0; features < 1u << RASTER_FEATURE_COUNT; features++) {
+        run("rasterTriangle_" + rasterFeaturesName(features), "micro", kernelTriangles, [&, features](int t, int n) {
+            for (int i = 0; i < kernelTriangles; i++) rasterTriangle(windows[t], kernelTriangle, features, Colour(0, 0, 255), kernelTexture.get(), &contexts[t].depth);
+        });
+    }
+
+    // the file read and conversion plus the mipmaps, without loadTexture's cache
+    run("readTexture", "micro", 1, [&](int t, int n) {
+        TextureMap texture("texture.ppm");
+        benchSink.fetch_add(texture.pixels.size(), std::memory_order_relaxed);
+    });
+
+    // 100x100 screen pixels over a rotated texture ~7.6 texels per pixel away, like a far off textured floor
+    TextureHandle texture = loadTexture("texture.ppm");
+    glm::vec2 texelSize(1.0f / texture->width, 1.0f / texture->height);
+    glm::vec2 uvPerPixelX = glm::vec2(7, 3) * texelSize, uvPerPixelY = glm::vec2(-3, 7) * texelSize;
+    for (int filter = 0; filter < FILTER_COUNT && texture->width > 0; filter++) {
+        run(std::string("sampleTexture_") + textureFilterName(TextureFilter(filter)), "micro", 100 * 100, [&, filter](int t, int n) {
+            uint32_t sum = 0;
+            for (int y = 0; y < 100; y++) {
+                for (int x = 0; x < 100; x++) {
+                    glm::vec2 uv = float(x) * uvPerPixelX + float(y) * uvPerPixelY;
+                    sum += sampleTexture(*texture, uv, uvPerPixelX, uvPerPixelY, TextureFilter(filter));
+                }
+            }
+            benchSink.fetch_add(sum, std::memory_order_relaxed);
+        });
+    }
+
+    // The access patterns a row-major texture is worst at, in both layouts, over a 256x256 pixel patch:
+    // rotated is 1 texel per pixel with the patch's rows running 60 degrees across texture rows (bilinear),
+    // minified is the pattern above at 256x256 (trilinear)
+    std::vector<std::shared_ptr<TextureMap>> layouts;
+    for (int layout = 0; layout < LAYOUT_COUNT && texture->width > 0; layout++) {
+        layouts.push_back(std::make_shared<TextureMap>("texture.ppm"));
+        applyTextureLayout(*layouts.back(), TextureLayout(layout));
+    }
+    glm::vec2 rotatedPerPixelX = glm::vec2(0.5f, 0.866f) * texelSize, rotatedPerPixelY = glm::vec2(-0.866f, 0.5f) * texelSize;
+    for (size_t layout = 0; layout < layouts.size(); layout++) {
+        std::string suffix = std::string("_") + textureLayoutName(TextureLayout(layout));
+        const TextureMap &map = *layouts[layout];
+        run("sampleRotated" + suffix, "micro", 256 * 256, [&](int t, int n) {
+            uint32_t sum = 0;
+            for (int y = 0; y < 256; y++) {
+                for (int x = 0; x < 256; x++) {
+                    sum += sampleBilinear(map, 0, float(x) * rotatedPerPixelX + float(y) * rotatedPerPixelY);
+                }
+            }
+            benchSink.fetch_add(sum, std::memory_order_relaxed);
+        });
+        run("sampleMinified" + suffix, "micro", 256 * 256, [&](int t, int n) {
+            uint32_t sum = 0;
+            float lod = mipLevel(map, uvPerPixelX, uvPerPixelY);
+            for (int y = 0; y < 256; y++) {
+                for (int x = 0; x < 256; x++) {
+                    sum += sampleTrilinear(map, float(x) * uvPerPixelX + float(y) * uvPerPixelY, lod);
+                }
+            }
+            benchSink.fetch_add(sum, std::memory_order_relaxed);
+        });
+    }
+
+    // the minified pattern again through a virtual texture with every page it needs resident, i.e. the page table
+    // lookup on top of sampleMinified_linear
+    if (texture->width > 0) {
+        bakeVirtualTexture("texture.ppm", "bench_texture.vt", 64);
+        VirtualTexture virtualTexture("bench_texture.vt");
+        float lod = virtualTexture.mipLevel(uvPerPixelX, uvPerPixelY);
+        auto sampleMinified = [&]() {
+            uint32_t sum = 0;
+            for (int y = 0; y < 256; y++) {
+                for (int x = 0; x < 256; x++) {
+                    sum += virtualTexture.sampleTrilinear(float(x) * uvPerPixelX + float(y) * uvPerPixelY, lod);
+                }
+            }
+            return sum;
+        };
+        sampleMinified();
+        virtualTexture.update();
+        virtualTexture.waitForPages();
+        virtualTexture.update();
+        run("sampleMinified_virtual", "micro", 256 * 256, [&](int t, int n) {
+            benchSink.fetch_add(sampleMinified(), std::memory_order_relaxed);
+        });
+        std::remove("bench_texture.vt");
+    }
+
+    // 16 points in each pixel of a 64x64 patch from every sequence, estimating how much of the pixel is on one side
+    // of an edge through its centre (half, at any angle), as antialiasing does: the RMS error of the estimates is
+    // added as a counter
+    const int patch = 64, patchSamples = 16;
+    auto edgeError = [&](SampleSequence sequence) {
+        double squaredError = 0;
+        for (int y = 0; y < patch; y++) {
+            for (int x = 0; x < patch; x++) {
+                float angle = float(x + y * patch) * 2.39996323f;
+                glm::vec2 normal(std::cos(angle), std::sin(angle));
+                int inside = 0;
+                for (int i = 0; i < patchSamples; i++) inside += glm::dot(pixelSample(sequence, x, y, i) - 0.5f, normal) < 0;
+                double error = double(inside) / patchSamples - 0.5;
+                squaredError += error * error;
+            }
+        }
+        return std::sqrt(squaredError / (patch * patch));
+    };
+    for (int sequence = 0; sequence < SEQUENCE_COUNT; sequence++) {
+        std::string name = std::string("pixelSample_") + sampleSequenceName(SampleSequence(sequence));
+        run(name, "micro", patch * patch * patchSamples, [&, sequence](int t, int n) {
+            benchSink.fetch_add(size_t(edgeError(SampleSequence(sequence)) * 1e6), std::memory_order_relaxed);
+        });
+        if (!results.empty() && results.back().name == name) {
+            results.back().counters.emplace_back("rms_error", edgeError(SampleSequence(sequence)));
+        }
+    }
+
+    const int rays = 1000;
+    run("getClosestIntersection", "micro", rays, [&](int t, int n) {
+        const RenderContext &context = contexts[t];
+        float hits = 0;
+        for (int i = 0; i < rays; i++) {
+            glm::vec3 rayDirection = glm::normalize(rayCoordinate(context, i % WIDTH, (i * 7) % HEIGHT, 60) - context.cameraPosition);
+            hits += getClosestIntersection(rayDirection, scene, context.cameraPosition).distanceFromCamera;
+        }
+        threadRayStats().primaryRays += rays;
+        rayStats.mergeThread();
+        benchSink.fetch_add(size_t(hits), std::memory_order_relaxed);
+    });
+
+    run("projectVertices", "micro", mesh->positions.size(), [&](int t, int n) {
+        CanvasPoint *projected = frameArena().allocate<CanvasPoint>(mesh->positions.size());
+        const RenderContext &context = contexts[t];
+        projectVertices(mesh->positions, projected, context.cameraPosition, context.camOrientation, context.focalLength, 180);
+        benchSink.fetch_add(size_t(mesh->positions.empty() ? 0 : projected[0].depth), std::memory_order_relaxed);
+    });
+
+    // failures, over the warm-up run and every iteration, is added as a counter and should be 0
+    std::atomic<int> jobFailures(0);
+    run("jobSystem", "macro", 1, [&](int t, int n) {
+        jobFailures += jobSystemRound();
+    });
+    if (!results.empty() && results.back().name == "jobSystem") {
+        results.back().counters.emplace_back("failures", jobFailures);
+        if (jobFailures > 0) std::cerr << "jobSystem: " << jobFailures << " checks failed" << std::endl;
+    }
+
+    run("rasterise", "macro", 1, [&](int t, int n) {
+        clearDepth(contexts[t].depth);
+        rasterise(windows[t], contexts[t], *mesh);
+    });
+
+    run("rayTrace", "macro", 1, [&](int t, int n) {
+        rayTrace(windows[t], contexts[t], scene);
+    });
+
+    // the kernel without the shadow ray, which is half the rays
+    RenderContext unshadowed;
+    unshadowed.rayTraceShadows = false;
+    run("rayTraceUnshadowed", "macro", 1, [&](int t, int n) {
+        rayTrace(windows[t], unshadowed, scene);
+    });
+
+    // 4 Sobol samples per pixel
+    RenderContext antialiased;
+    antialiased.raySamples = 4;
+    antialiased.raySampleSequence = SEQUENCE_SOBOL;
+    run("rayTraceAntialiased", "macro", 1, [&](int t, int n) {
+        rayTrace(windows[t], antialiased, scene);
+    });
+
+    run("savePPM", "macro", 1, [&](int t, int n) {
+        TraceScope trace("savePPM", "io");
+        windows[t].savePPM("bench_output_" + std::to_string(t) + ".ppm");
+    });
+    for (int t = 0; t < options.threads; t++) std::remove(("bench_output_" + std::to_string(t) + ".ppm").c_str());
+    return benchmarkRun;
+}
+
+int main(int argc, char *argv[]) {
+    BenchmarkOptions options = parseOptions(argc, argv);
+    std::unique_ptr<PerfCounters> perf;
+    if (options.usePerf) {
+        perf.reset(new PerfCounters());
+        if (perf->available()) options.perf = perf.get();
+        else std::cerr << "Hardware counters disabled: " << perf->error() << std::endl;
+    }
+    tracer.setThreadName("main");
+    jobs.start(options.threads, options.pinThreads);
+    if (!options.tracePath.empty()) tracer.start();
+    std::vector<BenchmarkRun> runs;
+    for (const std::string &spec : options.scenes) runs.push_back(runSuite(spec, options));
+    for (size_t i = 0; options.heatmapMetric != HEATMAP_OFF && i < options.scenes.size(); i++) {
+        MeshHandle mesh = loadSceneMesh(options.scenes[i]);
+        DrawingWindow window(WIDTH, HEIGHT);
+        CostHeatmap heatmap(WIDTH, HEIGHT);
+        heatmap.metric = options.heatmapMetric;
+        RenderContext context;
+        context.heatmap = &heatmap;
+        rayTrace(window, context, mesh->triangles);
+        heatmap.draw(window);
+        window.savePPM("heatmap_" + std::to_string(i) + ".ppm");
+        std::cerr << "Saved heatmap_" << i << ".ppm for " << options.scenes[i] << std::endl;
+    }
+    if (!options.tracePath.empty()) {
+        tracer.stop();
+        tracer.writeJson(options.tracePath);
+    }
+
+    if (options.jsonPath.empty()) {
+        writeJson(std::cout, options, runs);
+    } else {
+        std::ofstream jsonFile(options.jsonPath);
+        writeJson(jsonFile, options, runs);
+    }
+    return 0;
+}
@@ -0,0 +1,870 @@
+#include "Renderer.h"
+#include "CostHeatmap.h"
+#include "FrameArena.h"
+#include "FrameProfiler.h"
+#include "JobSystem.h"
+#include "RayStats.h"
+#include "Resources.h"
+#include "TextureAtlas.h"
+#include "TraceRecorder.h"
+#include "VertexStage.h"
+
+
+uint32_t colouring(Colour col) {
+    return (255 << 24) + (int(col.red) << 16) + (int(col.green) << 8) + int(col.blue);
+}
+std::map<std::string, Colour> readMtlFile(const std::string& filename, std::map<std::string, std::string> *textures){
+    std::ifstream readFile(filename);
+    std::map<std::string, Colour> palette;
+    std::string line, key;
+
+    while (std::getline(readFile, line)) {
+        auto tokens = split(line, ' ');
+
+        if (tokens[0] == "newmtl") {
+            key = tokens[1];
+        } else if (tokens[0] == "Kd") {
+            float r = std::stof(tokens[1]) * 255;
+            float g = std::stof(tokens[2]) * 255;
+            float b = std::stof(tokens[3]) * 255;
+
+            palette[key] = Colour(r, g, b);
+        } else if (tokens[0] == "map_Kd" && textures) {
+            (*textures)[key] = tokens[1];
+        }
+    }
+    return palette;
+}
+
+std::vector<ModelTriangle> readObjFile(const std::string& filename, float scalingFactor) {
+    return readObjMesh(filename, scalingFactor).triangles;
+}
+
+namespace {
+    enum ObjLineType : uint8_t { OBJ_OTHER, OBJ_VERTEX, OBJ_TEXTURE_POINT, OBJ_FACE, OBJ_USEMTL, OBJ_MTLLIB };
+
+    // One line of an OBJ file with its numbers already parsed, which is the slow part and needs nothing from the
+    // lines before it, so the whole file can be parsed in parallel
+    struct ObjLine {
+        ObjLineType type = OBJ_OTHER;
+        float values[3];        // v and vt
+        int vertices[3];        // f, from 0
+        int texturePoints[3];   // f, from 0, -1 if the corner has none
+        // usemtl and mtllib: where their name is in the file
+        size_t nameStart;
+        size_t nameLength;
+    };
+
+    // `start` is where the line starts in the file
+    ObjLine parseObjLine(const std::string &line, size_t start, float scalingFactor) {
+        ObjLine parsed;
+        auto tokens = split(line, ' ');
+        if (tokens[0] == "v") {
+            parsed.type = OBJ_VERTEX;
+            for (int k = 0; k < 3; k++) parsed.values[k] = std::stof(tokens[k + 1]) * scalingFactor;
+        } else if (tokens[0] == "vt") {
+            parsed.type = OBJ_TEXTURE_POINT;
+            for (int k = 0; k < 2; k++) parsed.values[k] = std::stof(tokens[k + 1]);
+        } else if (tokens[0] == "f") {
+            parsed.type = OBJ_FACE;
+            for (int k = 1; k <= 3; k++) {
+                parsed.vertices[k - 1] = std::stoi(tokens[k]) - 1;
+                // "v/vt" or "v/vt/vn"; a bare "v/" has no texture point
+                size_t slash = tokens[k].find('/');
+                bool textured = slash != std::string::npos && slash + 1 < tokens[k].size() && tokens[k][slash + 1] != '/';
+                parsed.texturePoints[k - 1] = textured ? std::stoi(tokens[k].substr(slash + 1)) - 1 : -1;
+            }
+        } else if (tokens[0] == "usemtl" || tokens[0] == "mtllib") {
+            parsed.type = tokens[0] == "usemtl" ? OBJ_USEMTL : OBJ_MTLLIB;
+            parsed.nameStart = start + tokens[0].size() + 1;
+            parsed.nameLength = tokens[1].size();
+        }
+        return parsed;
+    }
+}
+
+Mesh readObjMesh(const std::string& filename, float scalingFactor) {
+    TraceScope trace("readObjFile", "io");
+    // read in one go, in text mode like the MTL file; on Windows that takes out the \r of each \r\n, so `text` can
+    // come out shorter than the file
+    std::ifstream readFile(filename, std::ifstream::ate);
+    std::string text(readFile ? size_t(readFile.tellg()) : 0, '\0');
+    readFile.seekg(0);
+    readFile.read(&text[0], text.size());
+    text.resize(readFile ? text.size() : size_t(readFile.gcount()));
+
+    // Parsed in 256 KB chunks on the job system's threads. A chunk takes the lines starting inside it, running
+    // past its end if need be, so every line is parsed once.
+    const size_t chunkSize = 256 * 1024;
+    std::vector<std::vector<ObjLine>> chunks((text.size() + chunkSize - 1) / chunkSize);
+    jobs.parallelFor(0, text.size(), chunkSize, [&](size_t first, size_t last) {
+        std::vector<ObjLine> &lines = chunks[first / chunkSize];
+        // ~30 characters a line in the scenes we have
+        lines.reserve((last - first) / 24);
+        std::string line;
+        while (first > 0 && first < last && text[first - 1] != '\n') first++;
+        while (first < last) {
+            size_t end = std::min(text.find('\n', first), text.size());
+            line.assign(text, first, end - first);
+            lines.push_back(parseObjLine(line, first, scalingFactor));
+            first = end + 1;
+        }
+    });
+
+    // then put together in file order, since materials apply to the faces after them
+    Mesh mesh;
+    std::vector<ModelTriangle> &t = mesh.triangles;
+    std::vector<glm::vec3> objVector;
+    std::vector<TexturePoint> textureVector;
+    Colour col;
+    std::map<std::string, Colour> palette;
+    std::map<std::string, std::string> textureFiles;
+    std::map<std::string, int> textureIndices;
+    int texture = -1;
+
+    for (const std::vector<ObjLine> &chunk : chunks) {
+        for (const ObjLine &line : chunk) {
+            if (line.type == OBJ_VERTEX) {
+                objVector.emplace_back(line.values[0], line.values[1], line.values[2]);
+            }else if (line.type == OBJ_TEXTURE_POINT) {
+                textureVector.emplace_back(line.values[0], line.values[1]);
+            }else if(line.type == OBJ_FACE){
+                for (int k = 0; k < 3; k++) mesh.indices.push_back(line.vertices[k]);
+                t.emplace_back(objVector[line.vertices[0]], objVector[line.vertices[1]], objVector[line.vertices[2]], col);
+                for (int k = 0; k < 3; k++) {
+                    if (line.texturePoints[k] >= 0) t.back().texturePoints[k] = textureVector[line.texturePoints[k]];
+                }
+                if (texture != -1 && mesh.triangleTextures.empty()) mesh.triangleTextures.resize(t.size() - 1, -1);
+                if (!mesh.triangleTextures.empty()) mesh.triangleTextures.push_back(texture);
+            }else if (line.type == OBJ_USEMTL) {
+                std::string name = text.substr(line.nameStart, line.nameLength);
+                col = palette[name];
+                texture = -1;
+                auto file = textureFiles.find(name);
+                if (file != textureFiles.end()) {
+                    auto loaded = textureIndices.find(file->second);
+                    bool isVirtual = file->second.size() > 3 && file->second.compare(file->second.size() - 3, 3, ".vt") == 0;
+                    if (loaded == textureIndices.end() && isVirtual) {
+                        // numbered after the regular textures once they are all known, -2 is the first until then
+                        loaded = textureIndices.emplace(file->second, -2 - int(mesh.virtualTextures.size())).first;
+                        mesh.virtualTextures.push_back(loadVirtualTexture(file->second));
+                    } else if (loaded == textureIndices.end()) {
+                        loaded = textureIndices.emplace(file->second, int(mesh.textures.size())).first;
+                        mesh.textures.push_back(requestTexture(file->second));
+                    }
+                    texture = loaded->second;
+                }
+            }
+            else if (line.type == OBJ_MTLLIB) {
+                palette = readMtlFile(text.substr(line.nameStart, line.nameLength), &textureFiles);
+            }
+        }
+    }
+    mesh.positions.reserve(objVector.size());
+    for (const glm::vec3 &vertex : objVector) mesh.positions.emplace_back(vertex, 1.0f);
+    for (int &index : mesh.triangleTextures) {
+        if (index <= -2) index = int(mesh.textures.size()) - 2 - index;
+    }
+    packTextureAtlas(mesh);
+    return mesh;
+}
+namespace {
+    // What the raster kernel steps across a triangle: screen x, 1/z, and the texture point and brightness, which
+    // are divided by z too when it is perspective correct. All of them change linearly across the screen.
+    struct Varyings {
+        float x;
+        float inverseDepth;
+        float u;
+        float v;
+        float brightness;
+    };
+
+    Varyings operator+(const Varyings &a, const Varyings &b) {
+        return {a.x + b.x, a.inverseDepth + b.inverseDepth, a.u + b.u, a.v + b.v, a.brightness + b.brightness};
+    }
+    Varyings operator-(const Varyings &a, const Varyings &b) {
+        return {a.x - b.x, a.inverseDepth - b.inverseDepth, a.u - b.u, a.v - b.v, a.brightness - b.brightness};
+    }
+    Varyings operator*(const Varyings &a, float s) {
+        return {a.x * s, a.inverseDepth * s, a.u * s, a.v * s, a.brightness * s};
+    }
+    Varyings operator/(const Varyings &a, float s) {
+        return {a.x / s, a.inverseDepth / s, a.u / s, a.v / s, a.brightness / s};
+    }
+    Varyings &operator+=(Varyings &a, const Varyings &b) {
+        return a = a + b;
+    }
+    // like glm::mix
+    Varyings mix(const Varyings &a, const Varyings &b, float t) {
+        return a + (b - a) * t;
+    }
+
+    template <unsigned Features>
+    Varyings vertexVaryings(const CanvasPoint &point) {
+        float inverseDepth = 1 / point.depth;
+        float scale = Features & RASTER_PERSPECTIVE ? inverseDepth : 1;
+        return {point.x, inverseDepth, point.texturePoint.x * scale, point.texturePoint.y * scale, point.brightness * scale};
+    }
+
+    uint32_t scaleColour(uint32_t colour, float brightness) {
+        brightness = glm::clamp(brightness, 0.0f, 1.0f);
+        uint32_t red = uint32_t(((colour >> 16) & 0xFF) * brightness);
+        uint32_t green = uint32_t(((colour >> 8) & 0xFF) * brightness);
+        uint32_t blue = uint32_t((colour & 0xFF) * brightness);
+        return 0xFF000000 | (red << 16) | (green << 8) | blue;
+    }
+
+    // Mip level of the pixel whose varyings are `value`. With RASTER_PERSPECTIVE uv is (u/z) / (1/z), whose
+    // derivative varies over the triangle; without, the derivatives are the same everywhere.
+    template <unsigned Features, typename Texture>
+    float pixelMipLevel(const Texture &texture, const Varyings &value, const Varyings &perPixelX, const Varyings &perPixelY) {
+        glm::vec2 uvPerPixelX(perPixelX.u, perPixelX.v), uvPerPixelY(perPixelY.u, perPixelY.v);
+        if (Features & RASTER_PERSPECTIVE) {
+            glm::vec2 uv = glm::vec2(value.u, value.v) / value.inverseDepth;
+            uvPerPixelX = (uvPerPixelX - uv * perPixelX.inverseDepth) / value.inverseDepth;
+            uvPerPixelY = (uvPerPixelY - uv * perPixelY.inverseDepth) / value.inverseDepth;
+        }
+        return mipLevel(texture, uvPerPixelX, uvPerPixelY);
+    }
+
+    // The one triangle kernel behind filledTriangle, texturedTriangle and rasterTriangle. It fills every pixel whose
+    // centre row and column fall inside t, so triangles sharing an edge neither overlap nor leave gaps. Features
+    // are RasterFeature flags; being a template argument, every test on them is folded away and each combination
+    // gets its own inner loop. Texture is anything sampleTexture takes: a TextureMap or a VirtualTexture, sampled with
+    // `filter`. Only rows [minRow, maxRow) are drawn, so a band of the screen can be drawn on its own.
+    template <unsigned Features, typename Texture>
+    void rasterKernel(DrawingWindow &window, CanvasTriangle t, Colour col, const Texture *texture, TextureFilter filter,
+                      std::vector<std::vector<float>> *depth, int minRow = 0, int maxRow = HEIGHT) {
+        sortVertices(true, t);
+        Varyings top = vertexVaryings<Features>(t[0]);
+        Varyings middle = vertexVaryings<Features>(t[1]);
+        Varyings bottom = vertexVaryings<Features>(t[2]);
+
+        // the varyings are planes over the screen, so their change per pixel along x and y is the same everywhere
+        float area = (t[1].x - t[0].x) * (t[2].y - t[0].y) - (t[2].x - t[0].x) * (t[1].y - t[0].y);
+        if (area == 0) return;
+        Varyings perPixelX = ((middle - top) * (t[2].y - t[0].y) - (bottom - top) * (t[1].y - t[0].y)) / area;
+        Varyings perPixelY = ((bottom - top) * (t[1].x - t[0].x) - (middle - top) * (t[2].x - t[0].x)) / area;
+        uint32_t colour = colouring(col);
+        // the mip level is worked out at the ends of each span and interpolated between them, rather than per pixel
+        float triangleLod = 0;
+        if ((Features & RASTER_TEXTURE) && !(Features & RASTER_PERSPECTIVE)) triangleLod = pixelMipLevel<Features>(*texture, top, perPixelX, perPixelY);
+
+        int firstRow = std::max(minRow, int(std::ceil(t[0].y)));
+        int lastRow = std::min(maxRow - 1, int(std::ceil(t[2].y)) - 1);
+        for (int y = firstRow; y <= lastRow; y++) {
+            Varyings longEdge = mix(top, bottom, (y - t[0].y) / (t[2].y - t[0].y));
+            Varyings shortEdge = y < t[1].y ? mix(top, middle, (y - t[0].y) / (t[1].y - t[0].y))
+                                            : mix(middle, bottom, (y - t[1].y) / (t[2].y - t[1].y));
+            Varyings left = longEdge.x < shortEdge.x ? longEdge : shortEdge;
+            Varyings right = longEdge.x < shortEdge.x ? shortEdge : longEdge;
+
+            int firstColumn = std::max(0, int(std::ceil(left.x)));
+            int lastColumn = std::min(WIDTH - 1, int(std::ceil(right.x)) - 1);
+            if (firstColumn > lastColumn) continue;
+            Varyings step = (right - left) / (right.x - left.x);
+            // nothing varies per pixel without these, so the whole span is one colour
+            if (!(Features & (RASTER_DEPTH_TEST | RASTER_TEXTURE | RASTER_GOURAUD))) {
+                window.fillSpan(firstColumn, y, lastColumn - firstColumn + 1, colour);
+                continue;
+            }
+            Varyings value = left + step * (firstColumn - left.x);
+            float lod = triangleLod, lodStep = 0;
+            if ((Features & RASTER_TEXTURE) && (Features & RASTER_PERSPECTIVE) && filter != FILTER_NEAREST) {
+                lod = pixelMipLevel<Features>(*texture, value, perPixelX, perPixelY);
+                if (lastColumn > firstColumn) {
+                    Varyings last = value + step * float(lastColumn - firstColumn);
+                    lodStep = (pixelMipLevel<Features>(*texture, last, perPixelX, perPixelY) - lod) / (lastColumn - firstColumn);
+                }
+            }
+            for (int x = firstColumn; x <= lastColumn; x++, value += step, lod += lodStep) {
+                if ((Features & RASTER_DEPTH_TEST) && (*depth)[x][y] > value.inverseDepth) continue;
+                uint32_t pixel = colour;
+                if (Features & RASTER_TEXTURE) {
+                    glm::vec2 uv(value.u, value.v);
+                    if (Features & RASTER_PERSPECTIVE) uv /= value.inverseDepth;
+                    pixel = sampleTexture(*texture, uv, lod, filter);
+                }
+                if (Features & RASTER_GOURAUD) {
+                    pixel = scaleColour(pixel, Features & RASTER_PERSPECTIVE ? value.brightness / value.inverseDepth : value.brightness);
+                }
+                window.setPixelColour(x, y, pixel);
+                if (Features & RASTER_DEPTH_TEST) (*depth)[x][y] = value.inverseDepth;
+            }
+        }
+    }
+
+    // Steps a pixel at a time along the longer axis, depth tested on 1/z like the triangles when Features has
+    // RASTER_DEPTH_TEST (the other flags don't apply to lines)
+    template <unsigned Features>
+    void lineKernel(CanvasPoint from, CanvasPoint to, DrawingWindow &window, Colour col, std::vector<std::vector<float>> *depth) {
+        float xDiff = round(to.x - from.x);
+        float yDiff = round(to.y - from.y);
+        float zDiff = to.depth - from.depth;
+        // at least one step, so a line with both ends on the same pixel draws it instead of dividing by 0
+        float numberOfSteps = std::max(std::max(std::abs(xDiff), std::abs(yDiff)), 1.0f);
+        float xStepSize = xDiff / numberOfSteps;
+        float yStepSize = yDiff / numberOfSteps;
+        float zStepSize = zDiff / numberOfSteps;
+
+        uint32_t colour = colouring(col);
+        for (float i = 0.0; i <= numberOfSteps; i++) {
+            int x = round(from.x + (xStepSize * i));
+            int y = round(from.y + (yStepSize * i));
+            if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT) continue;
+            if (Features & RASTER_DEPTH_TEST) {
+                float inverseDepth = 1 / (from.depth + (zStepSize * i));
+                if ((*depth)[x][y] > inverseDepth) continue;
+                (*depth)[x][y] = inverseDepth;
+            }
+            window.setPixelColour(x, y, colour);
+        }
+    }
+
+    using RasterKernel = void (*)(DrawingWindow &, CanvasTriangle, Colour, const TextureMap *, TextureFilter, std::vector<std::vector<float>> *, int, int);
+
+    template <unsigned... Features>
+    std::array<RasterKernel, sizeof...(Features)> rasterKernels(std::integer_sequence<unsigned, Features...>) {
+        return {{&rasterKernel<Features, TextureMap>...}};
+    }
+}
+
+std::string rasterFeaturesName(unsigned features) {
+    static const char *names[RASTER_FEATURE_COUNT] = {"depth", "texture", "gouraud", "perspective"};
+    std::string name;
+    for (unsigned feature = 0; feature < RASTER_FEATURE_COUNT; feature++) {
+        if (!(features & (1u << feature))) continue;
+        if (!name.empty()) name += "+";
+        name += names[feature];
+    }
+    return name.empty() ? "flat" : name;
+}
+
+void rasterTriangle(DrawingWindow &window, CanvasTriangle t, unsigned features, Colour col, const TextureMap *texture, std::vector<std::vector<float>> *depth,
+                    TextureFilter filter) {
+    static const auto kernels = rasterKernels(std::make_integer_sequence<unsigned, 1u << RASTER_FEATURE_COUNT>());
+    kernels[features & ((1u << RASTER_FEATURE_COUNT) - 1)](window, t, col, texture, filter, depth, 0, HEIGHT);
+}
+
+void drawLine (CanvasPoint from, CanvasPoint to, DrawingWindow &window, Colour col) {
+    lineKernel<0>(from, to, window, col, nullptr);
+}
+
+void drawLine (CanvasPoint from, CanvasPoint to, DrawingWindow &window, Colour col, std::vector<std::vector<float>> &depth) {
+    lineKernel<RASTER_DEPTH_TEST>(from, to, window, col, &depth);
+}
+
+Colour randomColour(){
+    Pcg32 &random = threadRandom();
+    float r = random.nextBelow(256);
+    float g = random.nextBelow(256);
+    float b = random.nextBelow(256);
+    return Colour(r, g, b);
+}
+
+CanvasTriangle randomCanvasPoint(){
+    Pcg32 &random = threadRandom();
+    CanvasPoint v0 = CanvasPoint(random.nextBelow(WIDTH), random.nextBelow(HEIGHT));
+    CanvasPoint v1 = CanvasPoint(random.nextBelow(WIDTH), random.nextBelow(HEIGHT));
+    CanvasPoint v2 = CanvasPoint(random.nextBelow(WIDTH), random.nextBelow(HEIGHT));
+    return CanvasTriangle(v0, v1, v2);
+}
+
+void drawTriangle(DrawingWindow &window, CanvasTriangle t, Colour col) {
+    drawLine(t.v0(), t.v1(),window, col);
+    drawLine(t.v1(), t.v2(),window, col);
+    drawLine(t.v2(), t.v0(),window, col);
+}
+
+void drawTriangle(DrawingWindow &window, CanvasTriangle t, Colour col, std::vector<std::vector<float>>& depth) {
+    drawLine(t.v0(), t.v1(),window, col, depth);
+    drawLine(t.v1(), t.v2(),window, col,depth);
+    drawLine(t.v2(), t.v0(),window, col,depth);
+}
+
+void unfilledTriangle(DrawingWindow &window, std::vector<std::vector<float>>& depth) {
+    drawTriangle(window,randomCanvasPoint(),randomColour());
+}
+
+void sortVertices(bool yOrX, CanvasTriangle &t) {
+    int indices[3] = {0, 1, 2};
+
+    auto compare = [&](int a, int b) {
+        return yOrX ? t[a].y < t[b].y : t[a].x < t[b].x;
+    };
+    //좌표를 인덱스 배열을 기준으로 정렬
+    std::sort(indices, indices + 3, compare);
+    //정렬된 인덱스를 사용하여 좌표를 업데이트
+    CanvasPoint temp[3];
+    for (int i = 0; i < 3; ++i) {
+        temp[i] = t[indices[i]];
+    }
+    //정렬된 좌표를 원래의 CanvasTriangle에 복사
+    for (int i = 0; i < 3; ++i) {
+        t[i] = temp[i];
+    }
+}
+
+void leftToRight(CanvasPoint &left, CanvasPoint &right, CanvasTriangle &t) {
+    sortVertices(true, t);
+
+    float xDiff = t[2].x - t[0].x;
+    float yDiff = t[2].y - t[0].y;
+    float zDiff = t[2].depth - t[0].depth;
+
+    float proportion = (t[1].y-t[0].y) / yDiff;
+    float var1 = (xDiff * proportion) + t[0].x;
+    float var2 = (zDiff * proportion) + t[0].depth;
+
+    if (t[1].x < var1) {
+        left = t[1];
+        right = CanvasPoint(var1, t[1].y, var2);
+    } else {
+        left = CanvasPoint(var1, t[1].y, var2);
+        right = t[1];
+    }
+}
+
+void filledTriangle(DrawingWindow &window){
+    CanvasTriangle t = randomCanvasPoint();
+    Colour col = randomColour();
+    rasterKernel<0, TextureMap>(window, t, col, nullptr, FILTER_NEAREST, nullptr);
+    drawTriangle(window,t,Colour(255, 255, 255));
+}
+
+
+void filledTriangle(DrawingWindow &window, CanvasTriangle t, Colour col, std::vector<std::vector<float>> &depth){
+    rasterKernel<RASTER_DEPTH_TEST, TextureMap>(window, t, col, nullptr, FILTER_NEAREST, &depth);
+}
+
+
+uint32_t textureColour(const TextureMap &textureMap, glm::vec2 texturePoint) {
+    return fetchTexel(textureMap, 0, round(texturePoint.x), round(texturePoint.y));
+}
+
+
+void drawTexture(DrawingWindow &window, const TextureMap &textureMap, CanvasTriangle t, CanvasTriangle c) {
+
+    int numberOfRow = abs(c[0].y - c[1].y)+1; // +1 to draw it without any blackline in the triangle
+
+    Interpolator<glm::vec2> canvasLeft(glm::vec2(c[0].x, c[0].y), glm::vec2(c[1].x, c[1].y), numberOfRow);
+    Interpolator<glm::vec2> canvasRight(glm::vec2(c[0].x, c[0].y), glm::vec2(c[2].x, c[2].y), numberOfRow);
+
+    Interpolator<glm::vec2> left(glm::vec2(t[0].x, t[0].y), glm::vec2(t[1].x, t[1].y), numberOfRow);
+    Interpolator<glm::vec2> right(glm::vec2(t[0].x, t[0].y), glm::vec2(t[2].x, t[2].y), numberOfRow);
+
+    for (; !canvasLeft.done(); ++canvasLeft, ++canvasRight, ++left, ++right) {
+        int numberOfCol = round(canvasRight->x - canvasLeft->x);
+        int start = round(canvasLeft->x);
+        for (Interpolator<glm::vec2> texel(*left, *right, numberOfCol); !texel.done(); ++texel) {
+            window.setPixelColour(start++, canvasLeft->y, textureColour(textureMap, *texel));
+        }
+    }
+}
+
+
+void calculateTextureCoordinates(CanvasTriangle &t, CanvasTriangle &c, CanvasPoint &canvasLeft, CanvasPoint &canvasRight, CanvasPoint &left, CanvasPoint &right, const TextureMap &textureMap){
+    float lengthOfTri = (c[2].x - c[0].x) != 0 ? (canvasRight.x - c[0].x) / (c[2].x - c[0].x) : 0;
+// texture left, right
+
+    // leftToRight(left,right,t);
+    if (c[1].x == canvasLeft.x) {
+        left = t[1];                      // Xdiff                                           Ydiff
+        right = CanvasPoint(t[0].x + (t[2].x - t[0].x) * lengthOfTri, t[0].y + (t[2].y - t[0].y) * lengthOfTri);
+    } else {
+        right = t[1];                    // Xdiff                                            Ydiff
+        left = CanvasPoint(t[0].x + (t[2].x - t[0].x) * lengthOfTri, t[1].y + (t[2].y - t[1].y) * lengthOfTri);
+    }
+}
+//Constants
+
+
+CanvasPoint getCanvasIntersectionPoint(const RenderContext &context, glm::vec3 vertexPosition, float range) {
+    glm::vec3 distanceVec = (context.cameraPosition - vertexPosition) * context.camOrientation;
+    float a = context.focalLength * (distanceVec.x / -distanceVec.z);
+    float b = context.focalLength * (distanceVec.y / distanceVec.z);
+    CanvasPoint result = CanvasPoint(a * range + WIDTH/2 , b * range + HEIGHT/2);
+    result.depth = distanceVec.z;
+    return result;
+}
+
+void clearDepth(std::vector<std::vector<float>> &depth) {
+    for (auto &column : depth) {
+        std::fill(column.begin(), column.end(), INT32_MIN);
+    }
+}
+
+void lookAt(RenderContext &context) {
+    glm::mat3 &camOrientation = context.camOrientation;
+    camOrientation[2] = glm::normalize(context.cameraPosition);
+    camOrientation[1] = glm::normalize(glm::cross(camOrientation[2], camOrientation[0]));
+    camOrientation[0] = glm::normalize(glm::cross(glm::vec3(0,1,0), camOrientation[2]));
+    //forward - camOrientation[2]
+    //up - camOrientation[1]
+    //right - camOrientation[0]
+
+}
+// Vertex stage: every unique vertex is projected once into a buffer from the calling thread's frame arena, valid
+// until the arena is reset. Triangle setup then picks its three corners out by index.
+const CanvasPoint *projectMesh(const RenderContext &context, const Mesh &mesh) {
+    ScopedTimer timer(STAGE_PROJECT);
+    CanvasPoint *projected = frameArena().allocate<CanvasPoint>(mesh.positions.size());
+    projectVertices(mesh.positions, projected, context.cameraPosition, context.camOrientation, context.focalLength, 180);
+    return projected;
+}
+
+CanvasTriangle triangleSetup(const Mesh &mesh, const CanvasPoint *projected, size_t i) {
+    const uint32_t *index = &mesh.indices[3 * i];
+    CanvasTriangle triangle(projected[index[0]], projected[index[1]], projected[index[2]]);
+    // a shared position can have a different texture point in every triangle using it
+    for (int k = 0; k < 3; k++) {
+        triangle[k].texturePoint = mesh.triangles[i].texturePoints[k];
+    }
+    return triangle;
+}
+
+void wireframe(DrawingWindow& window, RenderContext &context, const Mesh &mesh) {
+    window.clearPixels();
+    const CanvasPoint *projected = projectMesh(context, mesh);
+    ScopedTimer timer(STAGE_RASTER);
+    for (size_t i = 0; i < mesh.triangles.size(); i++) {
+        drawTriangle(window, triangleSetup(mesh, projected, i), Colour(255,255,255),context.depth);
+    }
+}
+
+
+void rasterise(DrawingWindow& window, RenderContext &context, const Mesh &mesh) {
+
+    window.clearPixels();
+    std::vector<std::vector<float>> &depth = context.depth;
+    const CanvasPoint *projected = projectMesh(context, mesh);
+    ScopedTimer timer(STAGE_RASTER);
+    // looked up once per frame: the loaded texture or, until it arrives, the placeholder, held until drawn
+    ScratchVector<TextureHandle> textures(frameArena());
+    textures.reserve(mesh.textures.size());
+    for (const TextureRef &slot : mesh.textures) textures.push_back(slot->get());
+
+    // The screen is drawn in bands of rows, in parallel. A band draws the triangles reaching it in mesh order,
+    // clipped to its rows, so every pixel still sees the same triangles in the same order. A single thread draws
+    // one band, so it sets every triangle up once.
+    const int bandHeight = jobs.threadCount() > 1 ? 16 : HEIGHT, bandCount = (HEIGHT + bandHeight - 1) / bandHeight;
+    size_t triangleCount = mesh.triangles.size();
+    // bands each triangle reaches, first > last for none, then the triangles sorted by band: band b's are
+    // binned[offsets[b]] to binned[offsets[b + 1] - 1]
+    int *firstBands = frameArena().allocate<int>(triangleCount);
+    int *lastBands = frameArena().allocate<int>(triangleCount);
+    uint32_t *offsets = frameArena().allocate<uint32_t>(bandCount + 1);
+    for (size_t i = 0; i < triangleCount; i++) {
+        const uint32_t *index = &mesh.indices[3 * i];
+        float a = projected[index[0]].y, b = projected[index[1]].y, c = projected[index[2]].y;
+        float top = std::min(std::min(a, b), c), bottom = std::max(std::max(a, b), c);
+        // the kernel fills rows ceil(top) to ceil(bottom) - 1; where a NaN would end up is anyone's guess, so it
+        // goes everywhere
+        bool known = !std::isnan(a + b + c);
+        firstBands[i] = 1, lastBands[i] = 0;
+        if (known && (top > HEIGHT - 1 || bottom <= 0)) continue;
+        int firstRow = known && top > 0 ? int(std::ceil(top)) : 0;
+        int lastRow = known && bottom < HEIGHT ? int(std::ceil(bottom)) - 1 : HEIGHT - 1;
+        if (firstRow > lastRow) continue;
+        firstBands[i] = firstRow / bandHeight, lastBands[i] = lastRow / bandHeight;
+        for (int band = firstBands[i]; band <= lastBands[i]; band++) offsets[band + 1]++;
+    }
+    for (int band = 0; band < bandCount; band++) offsets[band + 1] += offsets[band];
+    uint32_t *binned = frameArena().allocate<uint32_t>(offsets[bandCount]);
+    uint32_t *cursors = frameArena().allocate<uint32_t>(bandCount);
+    std::copy(offsets, offsets + bandCount, cursors);
+    for (size_t i = 0; i < triangleCount; i++) {
+        for (int band = firstBands[i]; band <= lastBands[i]; band++) binned[cursors[band]++] = uint32_t(i);
+    }
+
+    const unsigned textured = RASTER_DEPTH_TEST | RASTER_TEXTURE | RASTER_PERSPECTIVE;
+    TextureFilter filter = context.textureFilter;
+    jobs.parallelFor(0, bandCount, 1, [&](size_t firstBand, size_t lastBand) {
+        for (size_t band = firstBand; band < lastBand; band++) {
+            int minRow = int(band) * bandHeight, maxRow = std::min(HEIGHT, minRow + bandHeight);
+            TraceScope trace("band", "raster", {"first_row", int64_t(minRow)});
+            for (uint32_t j = offsets[band]; j < offsets[band + 1]; j++) {
+                size_t i = binned[j];
+                int texture = mesh.textureIndex(i);
+                CanvasTriangle triangle = triangleSetup(mesh, projected, i);
+                if (texture >= int(textures.size())) {
+                    rasterKernel<textured>(window, triangle, Colour(), mesh.virtualTextures[texture - textures.size()].get(), filter, &depth, minRow, maxRow);
+                } else if (texture >= 0) {
+                    rasterKernel<textured>(window, triangle, Colour(), textures[texture].get(), filter, &depth, minRow, maxRow);
+                } else {
+                    rasterKernel<RASTER_DEPTH_TEST, TextureMap>(window, triangle, mesh.triangles[i].colour, nullptr, filter, &depth, minRow, maxRow);
+                }
+            }
+        }
+    });
+}
+
+
+void mapTexture(CanvasTriangle t, CanvasTriangle c, DrawingWindow &window, std::vector<std::vector<float>> &depth){
+    TextureHandle texture = loadTexture("texture.ppm");
+    const TextureMap &textureMap = *texture;
+    CanvasPoint canvasLeft,canvasRight,left,right;
+    leftToRight(canvasLeft,canvasRight,c);
+    leftToRight(left, right, t);
+    calculateTextureCoordinates(t, c, canvasLeft, canvasRight, left, right, textureMap);
+
+
+    drawTexture(window, textureMap, CanvasTriangle(t[0], left, right), CanvasTriangle(c[0], canvasLeft, canvasRight));
+    drawTexture(window, textureMap, CanvasTriangle(t[2], left, right), CanvasTriangle(c[2], canvasLeft, canvasRight));
+
+    CanvasTriangle calTriangle = CanvasTriangle(c[0],c[1],c[2]);
+    drawTriangle(window,calTriangle, Colour(255,255,255),depth);
+}
+
+void texturedTriangle(DrawingWindow &window, CanvasTriangle t, const TextureMap &texture, std::vector<std::vector<float>> &depth,
+                      TextureFilter filter) {
+    rasterKernel<RASTER_DEPTH_TEST | RASTER_TEXTURE | RASTER_PERSPECTIVE>(window, t, Colour(), &texture, filter, &depth);
+}
+
+void texturedTriangle(DrawingWindow &window, CanvasTriangle t, const VirtualTexture &texture, std::vector<std::vector<float>> &depth,
+                      TextureFilter filter) {
+    rasterKernel<RASTER_DEPTH_TEST | RASTER_TEXTURE | RASTER_PERSPECTIVE>(window, t, Colour(), &texture, filter, &depth);
+}
+
+void translateCamera(RenderContext &context, int i, bool positive) {
+    glm::vec3 &cameraPosition = context.cameraPosition;
+    // x
+    if (i == 0) {
+        if (positive) {
+            cameraPosition += glm::vec3(0.4, 0, 0);
+        } else {
+            cameraPosition -= glm::vec3(0.2, 0, 0);
+        }
+        //y
+    } else if (i == 1) {
+        if (positive) {
+            cameraPosition += glm::vec3(0, 0.2, 0);
+        } else {
+            cameraPosition -= glm::vec3(0, 0.2, 0);
+        }
+        //z
+    } else {
+        if (positive) {
+            cameraPosition += glm::vec3(0, 0, 0.2);
+        } else {
+            cameraPosition -= glm::vec3(0, 0, 0.2);
+        }
+    }
+}
+
+
+void rotateCamera(RenderContext &context, bool xAxis, float value) {
+    glm::mat3 mat;
+    if (xAxis) {
+        mat = glm::mat3(
+                1, 0, 0,
+                0, cos(value), sin(value),
+                0, -sin(value), cos(value));
+    } else {
+        mat = glm::mat3(
+                cos(value), 0, -sin(value),
+                0, 1, 0,
+                sin(value), 0, cos(value));
+    }
+    context.cameraPosition = context.cameraPosition * mat;
+}
+
+void changeOri(RenderContext &context, bool xAxis, float value) {
+    glm::mat3 m;
+    if (xAxis) {
+        m = glm::mat3(
+                1, 0, 0,
+                0, cos(value), sin(value),
+                0, -sin(value), cos(value));
+    } else {
+        m = glm::mat3(
+                cos(value), 0, -sin(value),
+                0, 1, 0,
+                sin(value), 0, cos(value));
+    }
+    context.camOrientation = context.camOrientation * m;
+}
+
+
+
+void orbit(RenderContext &context) {
+    if (context.rotate) {
+        rotateCamera(context, false, -PI / 400);
+        lookAt(context);
+    }
+}
+
+RayTriangleIntersection getClosestIntersection(glm::vec3& rayDirection, Span<ModelTriangle> triangles, glm::vec3 position, int triangleIndex) {
+
+    RayTriangleIntersection result = RayTriangleIntersection(glm::vec3(0, 0, 0), FLT_MAX, triangles[0], -1);
+
+    // distance along the ray and barycentric (u, v) of the nearest hit, by the kernel for this CPU
+    glm::vec3 possibleSolution;
+    size_t i = simdKernels().closestTriangle(triangles.data(), triangles.size(), &position[0], &rayDirection[0], size_t(triangleIndex), &possibleSolution[0]);
+    if (i != size_t(-1)) {
+        glm::vec3 e0 = triangles[i].vertices[1] - triangles[i].vertices[0];
+        glm::vec3 e1 = triangles[i].vertices[2] - triangles[i].vertices[0];
+        result = {triangles[i].vertices[0] + possibleSolution[1] * e0 + possibleSolution[2] * e1,
+                  possibleSolution[0], triangles[i], i};
+    }
+    RayStats &stats = threadRayStats();
+    stats.triangleTests += triangles.size();
+    if (result.triangleIndex != size_t(-1)) stats.hits++;
+    return result;
+}
+
+glm::vec3 rayCoordinate(const RenderContext &context, float width, float height, float range) {
+    glm::vec3 rayDirection;
+    rayDirection.x = (width - (float (WIDTH)/2)) * 1.0 / range;
+    rayDirection.y = (height - (float (HEIGHT)/2)) * -1.0 / range;
+    rayDirection.z = - context.focalLength;
+
+    return context.camOrientation * rayDirection;
+}
+
+float proximityLighting(const RenderContext &context, glm::vec3 trianglePoint, glm::vec3 normal) {
+    float brightLength = glm::length(context.lightPosition - trianglePoint);
+    float lightIntensity = 15 / (4 * M_PI * brightLength * brightLength);
+    if (lightIntensity > 1) lightIntensity = 1;
+    return lightIntensity;
+}
+
+bool isInShadow(const RayTriangleIntersection& lightPoint, const glm::vec3& lightPosition, const RayTriangleIntersection& t) {
+    return lightPoint.distanceFromCamera >= glm::distance(lightPosition, t.intersectionPoint) // t= closestIntersectTriangle
+           && t.triangleIndex != lightPoint.triangleIndex;
+}
+
+void lighting(Colour& colour, float brightness) {
+    brightness = std::max(brightness, 0.4f);
+    colour.red *= brightness;
+    colour.blue *= brightness;
+    colour.green *= brightness;
+}
+
+void rayTrace(DrawingWindow &window, const RenderContext &context, Span<ModelTriangle> modelT){
+    // 32x32 pixel tiles, shared out between the job system's threads
+    jobs.parallelForTiles(WIDTH, HEIGHT, 32, [&](size_t x, size_t y, size_t lastX, size_t lastY) {
+        rayTraceTile(window, context, modelT, x, y, lastX, lastY);
+    });
+}
+
+const char *lightingModelName(LightingModel model) {
+    static const char *names[LIGHTING_COUNT] = {"proximity", "diffuse", "unlit"};
+    return names[model];
+}
+
+LightingModel parseLightingModel(const std::string &name) {
+    for (int model = 0; model < LIGHTING_COUNT; model++) {
+        if (name == lightingModelName(LightingModel(model))) return LightingModel(model);
+    }
+    throw std::invalid_argument("Unknown lighting model `" + name + "`, expected proximity, diffuse or unlit");
+}
+
+namespace {
+    template <LightingModel Lighting>
+    Colour shade(const RenderContext &context, const RayTriangleIntersection &hit, glm::vec3 lightDirection) {
+        Colour colour = hit.intersectedTriangle.colour;
+        if (Lighting == LIGHTING_UNLIT) return colour;
+        const glm::vec3 *vertices = hit.intersectedTriangle.vertices.data();
+        glm::vec3 normal = glm::cross(vertices[1] - vertices[0], vertices[2] - vertices[0]);
+        float brightness = std::max(proximityLighting(context, hit.intersectionPoint, normal), 0.0f);
+        // either side of a triangle can face the light
+        if (Lighting == LIGHTING_DIFFUSE) brightness *= std::abs(glm::dot(glm::normalize(normal), lightDirection));
+        lighting(colour, brightness);
+        return colour;
+    }
+
+    // rayTraceTile for one combination of options. Being template arguments, they are tested once, when the kernel
+    // is picked, rather than for every pixel.
+    template <bool Shadows, LightingModel Lighting, HeatmapMetric Metric>
+    void traceKernel(DrawingWindow &window, const RenderContext &context, Span<ModelTriangle> modelT,
+                     size_t firstColumn, size_t firstRow, size_t lastColumn, size_t lastRow) {
+        glm::vec3 cameraPosition = context.cameraPosition, lightPosition = context.lightPosition;
+        // summed locally and handed to the profiler once, so threads don't fight over its counters for every pixel
+        std::chrono::steady_clock::duration primaryTime(0), shadowTime(0);
+        RayStats &stats = threadRayStats();
+        unsigned samples = std::max(context.raySamples, 1u);
+        for (size_t y = firstRow; y < lastRow; y++) {
+            for (size_t x = firstColumn; x < lastColumn; x++) {
+                uint64_t testsBefore = stats.triangleTests;
+                uint64_t nodesBefore = stats.nodesVisited;
+                std::chrono::steady_clock::time_point pixelStart;
+                if (Metric == HEATMAP_TIME) pixelStart = std::chrono::steady_clock::now();
+                // samples that miss or are in shadow count as black; the pixel is left alone if they all are
+                Colour colour;
+                unsigned red = 0, green = 0, blue = 0, litSamples = 0;
+                for (unsigned sample = 0; sample < samples; sample++) {
+                    glm::vec2 offset(0);
+                    if (samples > 1) offset = pixelSample(context.raySampleSequence, uint32_t(x), uint32_t(y), sample) - 0.5f;
+                    auto primaryStart = std::chrono::steady_clock::now();
+                    glm::vec3 rayDirection = glm::normalize(rayCoordinate(context, x + offset.x, y + offset.y, 60) - cameraPosition);
+                    RayTriangleIntersection closestIntersectTriangle = getClosestIntersection(rayDirection, modelT,cameraPosition);
+                    stats.primaryRays++;
+
+                    glm::vec3 lightDirection = glm::normalize(lightPosition - closestIntersectTriangle.intersectionPoint);
+                    bool lit = true;
+                    auto shadowStart = std::chrono::steady_clock::now();
+                    primaryTime += shadowStart - primaryStart;
+                    if (Shadows) {
+                        RayTriangleIntersection lightPoint = getClosestIntersection(lightDirection, modelT,closestIntersectTriangle.intersectionPoint, closestIntersectTriangle.triangleIndex);
+                        shadowTime += std::chrono::steady_clock::now() - shadowStart;
+                        stats.shadowRays++;
+                        lit = isInShadow(lightPoint, lightPosition, closestIntersectTriangle);
+                    }
+
+                    if (lit && closestIntersectTriangle.distanceFromCamera != FLT_MAX) {
+                        colour = shade<Lighting>(context, closestIntersectTriangle, lightDirection);
+                        red += colour.red;
+                        green += colour.green;
+                        blue += colour.blue;
+                        litSamples++;
+                    }
+                }
+
+                if (litSamples > 0) {
+                    if (samples > 1) colour = Colour((red + samples / 2) / samples, (green + samples / 2) / samples, (blue + samples / 2) / samples);
+                    window.setPixelColour(x, y, colouring(colour));
+                }
+
+                if (Metric == HEATMAP_TESTS) context.heatmap->record(x, y, float(stats.triangleTests - testsBefore));
+                else if (Metric == HEATMAP_NODES) context.heatmap->record(x, y, float(stats.nodesVisited - nodesBefore));
+                else if (Metric == HEATMAP_TIME) {
+                    context.heatmap->record(x, y, std::chrono::duration<float, std::nano>(std::chrono::steady_clock::now() - pixelStart).count());
+                }
+            }
+        }
+        profiler.add(STAGE_PRIMARY, primaryTime);
+        profiler.add(STAGE_SHADOW, shadowTime);
+    }
+
+    using TraceKernel = void (*)(DrawingWindow &, const RenderContext &, Span<ModelTriangle>, size_t, size_t, size_t, size_t);
+
+    template <bool Shadows, LightingModel Lighting>
+    TraceKernel selectTraceKernel(HeatmapMetric metric) {
+        switch (metric) {
+            case HEATMAP_TESTS: return &traceKernel<Shadows, Lighting, HEATMAP_TESTS>;
+            case HEATMAP_NODES: return &traceKernel<Shadows, Lighting, HEATMAP_NODES>;
+            case HEATMAP_TIME: return &traceKernel<Shadows, Lighting, HEATMAP_TIME>;
+            default: return &traceKernel<Shadows, Lighting, HEATMAP_OFF>;
+        }
+    }
+
+    template <bool Shadows>
+    TraceKernel selectTraceKernel(LightingModel lighting, HeatmapMetric metric) {
+        switch (lighting) {
+            case LIGHTING_DIFFUSE: return selectTraceKernel<Shadows, LIGHTING_DIFFUSE>(metric);
+            case LIGHTING_UNLIT: return selectTraceKernel<Shadows, LIGHTING_UNLIT>(metric);
+            default: return selectTraceKernel<Shadows, LIGHTING_PROXIMITY>(metric);
+        }
+    }
+}
+
+void rayTraceTile(DrawingWindow &window, const RenderContext &context, Span<ModelTriangle> modelT,
+                  size_t firstColumn, size_t firstRow, size_t lastColumn, size_t lastRow){
+    TraceScope trace("tile", "raytrace", {"x", int64_t(firstColumn)}, {"y", int64_t(firstRow)});
+    HeatmapMetric metric = context.heatmap ? context.heatmap->metric : HEATMAP_OFF;
+    TraceKernel kernel = context.rayTraceShadows ? selectTraceKernel<true>(context.lightingModel, metric)
+                                                 : selectTraceKernel<false>(context.lightingModel, metric);
+    kernel(window, context, modelT, firstColumn, firstRow, lastColumn, lastRow);
+    rayStats.mergeThread();
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <CanvasTriangle.h>
+#include <CanvasPoint.h>
+#include <Colour.h>
+#include <CostHeatmap.h>
+#include <DrawingWindow.h>
+#include <ModelTriangle.h>
+#include <RayTriangleIntersection.h>
+#include <SimdKernels.h>
+#include <TextureMap.h>
+#include <Mesh.h>
+#include <Span.h>
+#include <TextureSampler.h>
+#include <Sampling.h>
+#include <VirtualTexture.h>
+#include <Interpolator.h>
+#include <Utils.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define WIDTH 640
+#define HEIGHT 480
+#define PI 3.1415926
+
+// How rayTrace lights what its rays hit
+enum LightingModel {
+    LIGHTING_PROXIMITY,  // by distance from the light alone
+    LIGHTING_DIFFUSE,    // proximity times the cosine of the angle the light arrives at
+    LIGHTING_UNLIT,      // the material colour as it is
+    LIGHTING_COUNT
+};
+
+const char *lightingModelName(LightingModel model);
+// Throws std::invalid_argument for anything but proximity, diffuse or unlit
+LightingModel parseLightingModel(const std::string &name);
+
+// Everything one view is drawn with: its camera, light, depth buffer, texture filter, ray tracing options and
+// heatmap. The drawing and tracing functions take the context they draw, rather than reading globals, so any number
+// of views (e.g. the viewer's and each of the benchmark harness's threads') can be drawn at once, each into its own
+// window.
+struct RenderContext {
+    glm::vec3 cameraPosition = glm::vec3(0.0, 0.0, 4.0);
+    glm::vec3 lightPosition = glm::vec3(0.0, 0.4, 0.6);
+    float focalLength = 2.0;
+    glm::mat3 camOrientation = glm::mat3(1, 0, 0,
+                                         0, 1, 0,
+                                         0, 0, 1);
+    // 1/z of the nearest thing drawn so far, indexed [x][y]
+    std::vector<std::vector<float>> depth = std::vector<std::vector<float>>(WIDTH, std::vector<float>(HEIGHT, 0));
+    // orbit() turns the camera around the origin every frame while this is set
+    bool rotate = false;
+    // How rasterise samples textures. Set with --texture-filter, or cycled with 'k' in the viewer.
+    TextureFilter textureFilter = FILTER_TRILINEAR;
+
+    // Set with --lighting and --no-shadows, or cycled with 'j' and toggled with 'y' in the viewer. rayTraceTile picks
+    // the kernel compiled for them (and the heatmap metric) once per call.
+    LightingModel lightingModel = LIGHTING_PROXIMITY;
+    bool rayTraceShadows = true;
+    // Rays rayTrace sends through each pixel, spread over it by raySampleSequence (seeded per pixel, so an image
+    // doesn't depend on how tiles are shared between threads) and averaged. 1 sends one through (x, y) itself. Set
+    // with --samples and --sampler; 'u' in the viewer cycles between 1, 4 and 16 samples.
+    unsigned raySamples = 1;
+    SampleSequence raySampleSequence = SEQUENCE_SOBOL;
+    // Where rayTrace records each pixel's cost, in its metric, unless it is null or off. Views traced at the same
+    // time each need their own, as their pixels share its cells.
+    CostHeatmap *heatmap = nullptr;
+};
+
+uint32_t colouring(Colour col);
+
+// map_Kd texture file names, per material, go into `textures` when it is given
+std::map<std::string, Colour> readMtlFile(const std::string& filename, std::map<std::string, std::string> *textures = nullptr);
+std::vector<ModelTriangle> readObjFile(const std::string& filename, float scalingFactor);
+// Same as readObjFile but keeps the file's vertex indices, so no vertex merging is needed, and loads the
+// materials' map_Kd textures, packing the small ones into atlases (see packTextureAtlas). `vt` coordinates go into
+// texturePoints with (0, 0) as the texture's top left.
+Mesh readObjMesh(const std::string& filename, float scalingFactor);
+
+void drawLine(CanvasPoint from, CanvasPoint to, DrawingWindow &window, Colour col);
+void drawLine(CanvasPoint from, CanvasPoint to, DrawingWindow &window, Colour col, std::vector<std::vector<float>> &depth);
+Colour randomColour();
+CanvasTriangle randomCanvasPoint();
+void drawTriangle(DrawingWindow &window, CanvasTriangle t, Colour col);
+void drawTriangle(DrawingWindow &window, CanvasTriangle t, Colour col, std::vector<std::vector<float>>& depth);
+void unfilledTriangle(DrawingWindow &window, std::vector<std::vector<float>>& depth);
+void sortVertices(bool yOrX, CanvasTriangle &t);
+void leftToRight(CanvasPoint &left, CanvasPoint &right, CanvasTriangle &t);
+void filledTriangle(DrawingWindow &window);
+void filledTriangle(DrawingWindow &window, CanvasTriangle t, Colour col, std::vector<std::vector<float>> &depth);
+
+// What the triangle kernel does per pixel. Every combination is compiled into its own inner loop, so the drawing
+// functions pick theirs once per triangle instead of testing for each pixel.
+enum RasterFeature : unsigned {
+    RASTER_DEPTH_TEST = 1 << 0,   // keep the nearest, on 1/z in `depth`
+    RASTER_TEXTURE = 1 << 1,      // sample the texture at the interpolated texturePoints (uvs) instead of the colour
+    RASTER_GOURAUD = 1 << 2,      // scale the colour by the interpolated CanvasPoint brightness, clamped to [0, 1]
+    RASTER_PERSPECTIVE = 1 << 3,  // interpolate uvs and brightness perspective correctly rather than across the screen
+    RASTER_FEATURE_COUNT = 4
+};
+// e.g. "depth+texture", or "flat" for none
+std::string rasterFeaturesName(unsigned features);
+// Draws t with the kernel for a set of RasterFeature flags; `texture`, `depth` and `filter` are only used, and then
+// needed, when the flags say so
+void rasterTriangle(DrawingWindow &window, CanvasTriangle t, unsigned features, Colour col, const TextureMap *texture, std::vector<std::vector<float>> *depth,
+                    TextureFilter filter = FILTER_TRILINEAR);
+
+uint32_t textureColour(const TextureMap &textureMap, glm::vec2 texturePoint);
+void drawTexture(DrawingWindow &window, const TextureMap &textureMap, CanvasTriangle t, CanvasTriangle c);
+void calculateTextureCoordinates(CanvasTriangle &t, CanvasTriangle &c, CanvasPoint &canvasLeft, CanvasPoint &canvasRight, CanvasPoint &left, CanvasPoint &right, const TextureMap &textureMap);
+void mapTexture(CanvasTriangle t, CanvasTriangle c, DrawingWindow &window, std::vector<std::vector<float>> &depth);
+void texturedTriangle(DrawingWindow &window, CanvasTriangle t, const TextureMap &texture, std::vector<std::vector<float>> &depth,
+                      TextureFilter filter = FILTER_TRILINEAR);
+void texturedTriangle(DrawingWindow &window, CanvasTriangle t, const VirtualTexture &texture, std::vector<std::vector<float>> &depth,
+                      TextureFilter filter = FILTER_TRILINEAR);
+
+CanvasPoint getCanvasIntersectionPoint(const RenderContext &context, glm::vec3 vertexPosition, float range);
+const CanvasPoint *projectMesh(const RenderContext &context, const Mesh &mesh);
+CanvasTriangle triangleSetup(const Mesh &mesh, const CanvasPoint *projected, size_t i);
+void clearDepth(std::vector<std::vector<float>> &depth);
+void lookAt(RenderContext &context);
+// Both draw into the context's depth buffer, which the caller clears
+void wireframe(DrawingWindow& window, RenderContext &context, const Mesh &mesh);
+void rasterise(DrawingWindow& window, RenderContext &context, const Mesh &mesh);
+
+void translateCamera(RenderContext &context, int i, bool positive);
+void rotateCamera(RenderContext &context, bool xAxis, float value);
+void changeOri(RenderContext &context, bool xAxis, float value);
+void orbit(RenderContext &context);
+
+RayTriangleIntersection getClosestIntersection(glm::vec3& rayDirection, Span<ModelTriangle> triangles, glm::vec3 position, int triangleIndex = -1);
+glm::vec3 rayCoordinate(const RenderContext &context, float width, float height, float range);
+float proximityLighting(const RenderContext &context, glm::vec3 trianglePoint, glm::vec3 normal);
+bool isInShadow(const RayTriangleIntersection& lightPoint, const glm::vec3& lightPosition, const RayTriangleIntersection& t);
+void lighting(Colour& colour, float brightness);
+void rayTrace(DrawingWindow &window, const RenderContext &context, Span<ModelTriangle> modelT);
+// Traces only columns [firstColumn, lastColumn) of rows [firstRow, lastRow); rayTrace shares a frame's tiles out
+// between the job system's threads (see JobSystem.h)
+void rayTraceTile(DrawingWindow &window, const RenderContext &context, Span<ModelTriangle> modelT,
+                  size_t firstColumn, size_t firstRow, size_t lastColumn, size_t lastRow);
@@ -0,0 +1,34 @@
+#include "Resources.h"
+#include "Renderer.h"
+#include <map>
+#include <mutex>
+
+namespace {
+    template <typename T>
+    struct Cache {
+        std::mutex mutex;
+        std::map<std::string, std::weak_ptr<const T>> entries;
+    };
+    Cache<Mesh> meshes;
+
+    // Returns the cached resource for `key`, or loads it with `load` and caches it
+    template <typename T, typename Load>
+    std::shared_ptr<const T> findOrLoad(Cache<T> &cache, const std::string &key, Load load) {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        if (std::shared_ptr<const T> cached = cache.entries[key].lock()) return cached;
+        // loaded under the lock, so two threads asking for the same file don't both read it
+        std::shared_ptr<const T> loaded = std::make_shared<const T>(load());
+        cache.entries[key] = loaded;
+        return loaded;
+    }
+}
+
+MeshHandle loadMesh(const std::string &filename, float scalingFactor) {
+    return findOrLoad(meshes, filename + "@" + std::to_string(scalingFactor), [&]() {
+        return readObjMesh(filename, scalingFactor);
+    });
+}
+
+MeshHandle makeMesh(std::vector<ModelTriangle> triangles) {
+    return std::make_shared<const Mesh>(buildMesh(std::move(triangles)));
+}
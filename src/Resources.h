@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Mesh.h"
+#include <TextureMap.h>
+#include <memory>
+#include <string>
+
+// Meshes and textures are loaded once into immutable, reference counted storage and passed around as handles.
+// Neither Mesh nor TextureMap can be copied, so render code has to take them by const reference (or a
+// Span<ModelTriangle>) and can't end up duplicating a scene per call.
+// Textures have their own cache with background loading and a memory budget, see TextureCache.h.
+using MeshHandle = std::shared_ptr<const Mesh>;
+
+// Loads the file the first time. While any handle to it is alive, later calls with the same arguments return
+// the same storage instead of reading the file again. Safe to call from several threads.
+MeshHandle loadMesh(const std::string &filename, float scalingFactor);
+
+// Indexes an already built (e.g. generated) triangle list, see buildMesh. Not cached.
+MeshHandle makeMesh(std::vector<ModelTriangle> triangles);
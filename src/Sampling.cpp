@@ -0,0 +1,231 @@
+#include "Sampling.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+const uint64_t Pcg32::multiplier;
+
+void Pcg32::advance(uint64_t delta) {
+    // state' = a * state + c applied delta times is itself an affine map, built by squaring
+    uint64_t stepMultiplier = multiplier, stepIncrement = increment;
+    uint64_t totalMultiplier = 1, totalIncrement = 0;
+    for (; delta; delta >>= 1) {
+        if (delta & 1) {
+            totalMultiplier *= stepMultiplier;
+            totalIncrement = totalIncrement * stepMultiplier + stepIncrement;
+        }
+        stepIncrement = (stepMultiplier + 1) * stepIncrement;
+        stepMultiplier *= stepMultiplier;
+    }
+    state = totalMultiplier * state + totalIncrement;
+}
+
+namespace {
+    // SplitMix64's finaliser: every input bit affects every output bit
+    uint64_t mix64(uint64_t value) {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+    uint64_t pixelKey(uint32_t x, uint32_t y, uint32_t seed) {
+        return mix64((uint64_t(seed) << 40) ^ (uint64_t(y) << 20) ^ x);
+    }
+
+    uint32_t hashCombine(uint32_t seed, uint32_t value) {
+        return seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+    }
+
+    uint32_t reverseBits(uint32_t value) {
+        value = (value << 16) | (value >> 16);
+        value = ((value & 0x00ff00ffu) << 8) | ((value & 0xff00ff00u) >> 8);
+        value = ((value & 0x0f0f0f0fu) << 4) | ((value & 0xf0f0f0f0u) >> 4);
+        value = ((value & 0x33333333u) << 2) | ((value & 0xccccccccu) >> 2);
+        return ((value & 0x55555555u) << 1) | ((value & 0xaaaaaaaau) >> 1);
+    }
+
+    // Laine and Karras' hash: each bit only depends on itself and the bits below it, so on the bit reversed value it
+    // permutes every subtree of digits, which is what an Owen scramble is
+    uint32_t nestedUniformScramble(uint32_t value, uint32_t seed) {
+        value = reverseBits(value);
+        value += seed;
+        value ^= value * 0x6c50b47cu;
+        value ^= value * 0xb82f1e52u;
+        value ^= value * 0xc7afe638u;
+        value ^= value * 0x8d22f6e6u;
+        return reverseBits(value);
+    }
+
+    float unitFloat(uint32_t bits) {
+        return float(bits >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Sobol dimension 0 is the base 2 radical inverse; dimension 1's direction numbers (x + 1, all m = 1) make the
+    // generator matrix Pascal's triangle mod 2
+    uint32_t sobolDimension1(uint32_t index) {
+        uint32_t result = 0;
+        for (uint32_t direction = 1u << 31; index; index >>= 1, direction ^= direction >> 1) {
+            if (index & 1) result ^= direction;
+        }
+        return result;
+    }
+
+    const int blueNoiseSize = 64;
+
+    // Ulichney's void-and-cluster on a torus: spread out a random 10% of the cells, then rank them by taking away
+    // the most clustered one at a time, and the rest by filling the biggest gap at a time. The first n cells by rank
+    // are evenly spread for every n.
+    std::vector<float> buildBlueNoise() {
+        const int size = blueNoiseSize, cells = size * size;
+        const float sigma = 1.5f;
+        // Gaussian of the wrapped distance from cell 0
+        std::vector<float> kernel(cells);
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                int dx = std::min(x, size - x), dy = std::min(y, size - y);
+                kernel[y * size + x] = std::exp(-float(dx * dx + dy * dy) / (2 * sigma * sigma));
+            }
+        }
+        std::vector<char> points(cells, 0);
+        std::vector<float> energy(cells, 0);
+        auto set = [&](int cell, bool on) {
+            points[cell] = on;
+            float sign = on ? 1.0f : -1.0f;
+            int cellX = cell % size, cellY = cell / size;
+            for (int y = 0; y < size; y++) {
+                const float *row = &kernel[((y - cellY) & (size - 1)) * size];
+                for (int x = 0; x < size; x++) energy[y * size + x] += sign * row[(x - cellX) & (size - 1)];
+            }
+        };
+        // the point with the most energy around it, and the empty cell with the least
+        auto tightestCluster = [&]() {
+            int best = -1;
+            for (int cell = 0; cell < cells; cell++) {
+                if (points[cell] && (best < 0 || energy[cell] > energy[best])) best = cell;
+            }
+            return best;
+        };
+        auto largestVoid = [&]() {
+            int best = -1;
+            for (int cell = 0; cell < cells; cell++) {
+                if (!points[cell] && (best < 0 || energy[cell] < energy[best])) best = cell;
+            }
+            return best;
+        };
+
+        Pcg32 random(1);
+        const int initial = cells / 10;
+        for (int placed = 0; placed < initial;) {
+            int cell = int(random.nextBelow(cells));
+            if (!points[cell]) set(cell, true), placed++;
+        }
+        // move the most clustered point into the biggest gap until that is where it came from
+        for (int moves = 0; moves < cells; moves++) {
+            int cluster = tightestCluster();
+            set(cluster, false);
+            int gap = largestVoid();
+            set(gap, true);
+            if (gap == cluster) break;
+        }
+        std::vector<char> prototypePoints = points;
+        std::vector<float> prototypeEnergy = energy;
+
+        std::vector<float> ranks(cells);
+        for (int rank = initial - 1; rank >= 0; rank--) {
+            int cell = tightestCluster();
+            set(cell, false);
+            ranks[cell] = float(rank);
+        }
+        points.swap(prototypePoints);
+        energy.swap(prototypeEnergy);
+        for (int rank = initial; rank < cells; rank++) {
+            int cell = largestVoid();
+            set(cell, true);
+            ranks[cell] = float(rank);
+        }
+        for (float &rank : ranks) rank = (rank + 0.5f) / cells;
+        return ranks;
+    }
+}
+
+Pcg32 pixelRandom(uint32_t x, uint32_t y, uint32_t seed) {
+    uint64_t key = pixelKey(x, y, seed);
+    return Pcg32(key, mix64(key));
+}
+
+Pcg32 &threadRandom() {
+    static std::atomic<uint64_t> streams{0};
+    thread_local Pcg32 random(0x853c49e6748fea9bULL, streams.fetch_add(1));
+    return random;
+}
+
+float radicalInverse(uint32_t base, uint32_t index) {
+    if (base == 2) return unitFloat(reverseBits(index));
+    // digits are accumulated as an integer and divided once, so the result stays exact as long as it fits
+    uint64_t reversed = 0, scale = 1;
+    for (; index; index /= base) {
+        reversed = reversed * base + index % base;
+        scale *= base;
+    }
+    return std::min(float(double(reversed) / double(scale)), 1.0f - 1.0f / 16777216.0f);
+}
+
+glm::vec2 halton(uint32_t index) {
+    return glm::vec2(radicalInverse(2, index), radicalInverse(3, index));
+}
+
+glm::vec2 sobol(uint32_t index, uint32_t seed) {
+    if (seed == 0) return glm::vec2(unitFloat(reverseBits(index)), unitFloat(sobolDimension1(index)));
+    // shuffling the index as well keeps the points of a prefix from lining up between seeds
+    index = nestedUniformScramble(index, hashCombine(seed, 0));
+    return glm::vec2(unitFloat(nestedUniformScramble(reverseBits(index), hashCombine(seed, 1))),
+                     unitFloat(nestedUniformScramble(sobolDimension1(index), hashCombine(seed, 2))));
+}
+
+float blueNoise(uint32_t x, uint32_t y) {
+    static const std::vector<float> mask = buildBlueNoise();
+    return mask[(y % blueNoiseSize) * blueNoiseSize + x % blueNoiseSize];
+}
+
+const char *sampleSequenceName(SampleSequence sequence) {
+    static const char *names[SEQUENCE_COUNT] = {"random", "halton", "sobol", "blue-noise"};
+    return names[sequence];
+}
+
+SampleSequence parseSampleSequence(const std::string &name) {
+    for (int sequence = 0; sequence < SEQUENCE_COUNT; sequence++) {
+        if (name == sampleSequenceName(SampleSequence(sequence))) return SampleSequence(sequence);
+    }
+    throw std::invalid_argument("Unknown sample sequence `" + name + "`, expected random, halton, sobol or blue-noise");
+}
+
+glm::vec2 pixelSample(SampleSequence sequence, uint32_t x, uint32_t y, uint32_t index, uint32_t seed) {
+    switch (sequence) {
+        case SEQUENCE_HALTON: {
+            // Cranley-Patterson rotation: the whole sequence shifted around the torus by a per pixel offset
+            Pcg32 random = pixelRandom(x, y, seed);
+            glm::vec2 offset(random.nextFloat(), random.nextFloat());
+            return glm::fract(halton(index) + offset);
+        }
+        case SEQUENCE_SOBOL:
+            return sobol(index, uint32_t(pixelKey(x, y, seed)) | 1);
+        case SEQUENCE_BLUE_NOISE: {
+            // the R2 sequence's steps (1/g, 1/g^2 for the plastic number g); the second dimension reads the mask half
+            // a tile away, where it is uncorrelated with the first
+            const double step[2] = {0.7548776662466927, 0.5698402909980532};
+            uint32_t shift = uint32_t(mix64(seed));
+            glm::vec2 offset(blueNoise(x + shift, y + (shift >> 8)),
+                             blueNoise(x + shift + blueNoiseSize / 2, y + (shift >> 8) + blueNoiseSize / 2));
+            // stepped in double, so far into the sequence the points don't snap to a coarse grid
+            glm::vec2 progress(std::fmod(index * step[0], 1.0), std::fmod(index * step[1], 1.0));
+            return glm::fract(offset + progress);
+        }
+        default: {
+            Pcg32 random = pixelRandom(x, y, seed);
+            random.advance(2 * uint64_t(index));
+            return glm::vec2(random.nextFloat(), random.nextFloat());
+        }
+    }
+}
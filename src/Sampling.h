@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+
+// Random numbers and sample points for anything stochastic. Nothing here shares mutable state between threads: a
+// render seeds a generator from the pixel (pixelRandom) or scrambles a sequence per pixel (pixelSample), so what a
+// pixel gets doesn't depend on which thread draws it, or when.
+
+// PCG32 (XSH RR, 64 bit state): a few instructions per number and statistically far better than rand(), which
+// glibc also serialises on a global lock. Different streams from the same seed are independent.
+class Pcg32 {
+public:
+    explicit Pcg32(uint64_t seed = 0x853c49e6748fea9bULL, uint64_t stream = 0xda3e39cb94b95bdbULL)
+        : increment((stream << 1) | 1) {
+        next();
+        state += seed;
+        next();
+    }
+
+    uint32_t next() {
+        uint64_t old = state;
+        state = old * multiplier + increment;
+        uint32_t xorShifted = uint32_t(((old >> 18) ^ old) >> 27);
+        uint32_t rotation = uint32_t(old >> 59);
+        return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+    }
+
+    // Uniform in [0, bound), without the bias of next() % bound (Lemire's multiply and reject)
+    uint32_t nextBelow(uint32_t bound) {
+        uint64_t product = uint64_t(next()) * bound;
+        if (uint32_t(product) < bound) {
+            uint32_t threshold = (0u - bound) % bound;
+            while (uint32_t(product) < threshold) product = uint64_t(next()) * bound;
+        }
+        return uint32_t(product >> 32);
+    }
+
+    // Uniform in [0, 1)
+    float nextFloat() {
+        return float(next() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Skips `delta` numbers in O(log delta) steps
+    void advance(uint64_t delta);
+
+private:
+    static const uint64_t multiplier = 6364136223846793005ULL;
+    uint64_t state = 0;
+    uint64_t increment;
+};
+
+// A generator for pixel (x, y), the same whichever thread asks. `seed` picks another set, e.g. per frame.
+Pcg32 pixelRandom(uint32_t x, uint32_t y, uint32_t seed = 0);
+// The calling thread's own generator, for things that aren't per pixel (randomColour and the like). Threads get
+// streams numbered in the order they first ask, so a single threaded run always sees the same numbers.
+Pcg32 &threadRandom();
+
+// Low discrepancy building blocks, all in [0, 1)
+// The base `base` digits of `index` mirrored about the point
+float radicalInverse(uint32_t base, uint32_t index);
+// Halton points: radical inverses in bases 2 and 3
+glm::vec2 halton(uint32_t index);
+// The first two dimensions of the Sobol sequence, a (0, 2) sequence, so every power of two prefix puts one point in
+// each cell of any grid of that many equal rectangles. A nonzero `seed` Owen scrambles it (hashed, Burley 2020):
+// still stratified, but with no structure shared between seeds.
+glm::vec2 sobol(uint32_t index, uint32_t seed = 0);
+// A 64x64 void-and-cluster blue noise mask, repeating: neighbouring values are as different as possible, so any
+// threshold of it gives evenly spread pixels. Built the first time it is used.
+float blueNoise(uint32_t x, uint32_t y);
+
+// Where pixelSample's points come from
+enum SampleSequence {
+    SEQUENCE_RANDOM,      // independent PCG32 numbers (white noise), error falling as 1/sqrt(n)
+    SEQUENCE_HALTON,      // Halton, shifted by a random offset per pixel
+    SEQUENCE_SOBOL,       // Sobol, Owen scrambled per pixel
+    SEQUENCE_BLUE_NOISE,  // the R2 sequence, shifted per pixel by the blue noise mask, so error is blue noise too
+    SEQUENCE_COUNT
+};
+
+const char *sampleSequenceName(SampleSequence sequence);
+// Throws std::invalid_argument for anything but random, halton, sobol or blue-noise
+SampleSequence parseSampleSequence(const std::string &name);
+// Point `index` in [0, 1)^2 of pixel (x, y)'s sequence. Each pixel's points are decorrelated from its neighbours'
+// (with the same seed), and are a pure function of the arguments.
+glm::vec2 pixelSample(SampleSequence sequence, uint32_t x, uint32_t y, uint32_t index, uint32_t seed = 0);
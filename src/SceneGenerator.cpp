@@ -0,0 +1,155 @@
+#include "SceneGenerator.h"
+#include "Renderer.h"
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+std::vector<ModelTriangle> generateSphere(size_t triangleCount) {
+    // the two polar caps have one triangle per slice, every other stack has two
+    size_t slices = std::max<size_t>(3, size_t(std::sqrt(triangleCount / 2.0)));
+    size_t stacks = std::max<size_t>(2, (triangleCount / slices + 2) / 2);
+    float radius = 0.8f;
+
+    auto point = [&](size_t stack, size_t slice) {
+        float theta = PI * stack / stacks;
+        float phi = 2 * PI * slice / slices;
+        return glm::vec3(radius * std::sin(theta) * std::cos(phi), radius * std::cos(theta), radius * std::sin(theta) * std::sin(phi));
+    };
+
+    std::vector<ModelTriangle> triangles;
+    triangles.reserve(slices * (2 * stacks - 2));
+    for (size_t stack = 0; stack < stacks; stack++) {
+        Colour col = Colour(255 * stack / stacks, 64, 255 - 255 * stack / stacks);
+        for (size_t slice = 0; slice < slices; slice++) {
+            glm::vec3 a = point(stack, slice);
+            glm::vec3 b = point(stack, slice + 1);
+            glm::vec3 c = point(stack + 1, slice);
+            glm::vec3 d = point(stack + 1, slice + 1);
+            if (stack != 0) triangles.emplace_back(a, b, d, col);
+            if (stack != stacks - 1) triangles.emplace_back(a, d, c, col);
+        }
+    }
+    return triangles;
+}
+
+std::vector<ModelTriangle> generateTriangleSoup(size_t triangleCount, unsigned int seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+    std::uniform_int_distribution<int> channel(0, 255);
+    // triangles as wide as the average spacing of their centres (n^-1/3), so they stay about as crowded at any count;
+    // the total area does grow, as n^1/3
+    float size = 2.0f / std::cbrt(float(std::max<size_t>(triangleCount, 1)));
+
+    std::vector<ModelTriangle> triangles;
+    triangles.reserve(triangleCount);
+    for (size_t i = 0; i < triangleCount; i++) {
+        glm::vec3 centre(position(random), position(random), position(random));
+        glm::vec3 v0 = centre + size * glm::vec3(position(random), position(random), position(random));
+        glm::vec3 v1 = centre + size * glm::vec3(position(random), position(random), position(random));
+        glm::vec3 v2 = centre + size * glm::vec3(position(random), position(random), position(random));
+        triangles.emplace_back(v0, v1, v2, Colour(channel(random), channel(random), channel(random)));
+    }
+    return triangles;
+}
+
+std::vector<ModelTriangle> generateInstances(const std::vector<ModelTriangle> &box, size_t triangleCount) {
+    if (box.empty()) return {};
+    size_t copies = std::max<size_t>(1, (triangleCount + box.size() - 1) / box.size());
+    size_t side = 1;
+    while (side * side * side < copies) side++;
+    float scale = 1.0f / side;
+
+    std::vector<ModelTriangle> triangles;
+    triangles.reserve(copies * box.size());
+    for (size_t i = 0; i < copies; i++) {
+        glm::vec3 cell(float(i % side), float(i / side % side), float(i / (side * side)));
+        glm::vec3 offset = (2.0f * cell + 1.0f) * scale - 1.0f;
+        for (ModelTriangle triangle : box) {
+            for (glm::vec3 &vertex : triangle.vertices) vertex = vertex * scale + offset;
+            triangles.push_back(triangle);
+        }
+    }
+    return triangles;
+}
+
+std::vector<ModelTriangle> generateSlivers(size_t triangleCount, unsigned int seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+
+    std::vector<ModelTriangle> triangles;
+    triangles.reserve(triangleCount);
+    for (size_t i = 0; i < triangleCount; i++) {
+        glm::vec3 from(position(random), position(random), position(random));
+        glm::vec3 to = -from;
+        glm::vec3 width = 0.002f * glm::vec3(position(random), position(random), position(random));
+        triangles.emplace_back(from, to, from + width, Colour(200, 200, 200));
+    }
+    return triangles;
+}
+
+std::vector<ModelTriangle> generateScene(const std::string &spec) {
+    size_t colon = spec.find(':');
+    if (colon == std::string::npos) return readObjFile(spec, 0.35);
+
+    std::string kind = spec.substr(0, colon);
+    // std::stod accepts "1e6" as well as "1000000", but also "nan" and "inf", and throws std::out_of_range on "1e400"
+    double count;
+    try {
+        count = std::stod(spec.substr(colon + 1));
+    } catch (const std::out_of_range &) {
+        throw std::invalid_argument("Scene `" + spec + "` needs between 1 and 1e9 triangles");
+    } catch (const std::invalid_argument &) {
+        throw std::invalid_argument("Scene `" + spec + "` needs a triangle count after the colon");
+    }
+    // A billion triangles is already far more memory than any machine this runs on, and keeps size_t(count) defined
+    if (!std::isfinite(count) || count < 1 || count > 1e9) {
+        throw std::invalid_argument("Scene `" + spec + "` needs between 1 and 1e9 triangles");
+    }
+    size_t triangleCount = size_t(count);
+
+    if (kind == "sphere") return generateSphere(triangleCount);
+    if (kind == "soup") return generateTriangleSoup(triangleCount, 1);
+    if (kind == "cornell") return generateInstances(readObjFile("cornell-box.obj", 0.35), triangleCount);
+    if (kind == "slivers") return generateSlivers(triangleCount, 1);
+    throw std::invalid_argument("Unknown scene generator `" + kind + "`, expected sphere, soup, cornell or slivers");
+}
+
+MeshHandle loadSceneMesh(const std::string &spec) {
+    if (spec.find(':') == std::string::npos) return loadMesh(spec, 0.35);
+    return makeMesh(generateScene(spec));
+}
+
+void writeObjFile(const std::string &filename, const std::string &mtlFilename, const std::vector<ModelTriangle> &triangles, float scalingFactor) {
+    std::ofstream mtlFile(mtlFilename);
+    std::ofstream objFile(filename);
+    // 9 significant digits are enough for any float to read back as itself
+    mtlFile.precision(9);
+    objFile.precision(9);
+    objFile << "mtllib " << mtlFilename << "\n";
+
+    // readMtlFile truncates Kd * 255, so each channel is written in the middle of its step (255 as 1)
+    auto kd = [](int channel) { return std::min((channel + 0.5) / 255, 1.0); };
+    std::map<uint32_t, std::string> materials;
+    std::string currentMaterial;
+    size_t vertexIndex = 1;
+    for (const ModelTriangle &triangle : triangles) {
+        uint32_t key = colouring(triangle.colour);
+        auto material = materials.find(key);
+        if (material == materials.end()) {
+            std::string name = "m" + std::to_string(materials.size());
+            material = materials.emplace(key, name).first;
+            mtlFile << "newmtl " << name << "\n";
+            mtlFile << "Kd " << kd(triangle.colour.red) << " " << kd(triangle.colour.green) << " " << kd(triangle.colour.blue) << "\n\n";
+        }
+        if (material->second != currentMaterial) {
+            currentMaterial = material->second;
+            objFile << "usemtl " << currentMaterial << "\n";
+        }
+        for (const glm::vec3 &vertex : triangle.vertices) {
+            glm::vec3 v = vertex / scalingFactor;
+            objFile << "v " << v.x << " " << v.y << " " << v.z << "\n";
+        }
+        objFile << "f " << vertexIndex << "/ " << vertexIndex + 1 << "/ " << vertexIndex + 2 << "/\n";
+        vertexIndex += 3;
+    }
+}
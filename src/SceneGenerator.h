@@ -0,0 +1,30 @@
+#pragma once
+
+#include <ModelTriangle.h>
+#include <Resources.h>
+#include <string>
+#include <vector>
+
+// Procedural stress scenes for scaling tests. Every generator returns roughly `triangleCount` triangles that
+// fit inside the same [-1, 1] volume as the scaled cornell box, so the default camera sees all of them.
+// Note a ModelTriangle is ~100 bytes, so 10^8 triangles needs ~10GB of memory.
+
+// UV sphere of radius 0.8 centred at the origin
+std::vector<ModelTriangle> generateSphere(size_t triangleCount);
+// Small randomly placed and oriented triangles
+std::vector<ModelTriangle> generateTriangleSoup(size_t triangleCount, unsigned int seed);
+// A lattice of scaled copies of `box` (e.g. the cornell box), enough copies to reach triangleCount
+std::vector<ModelTriangle> generateInstances(const std::vector<ModelTriangle> &box, size_t triangleCount);
+// Long, very thin triangles crossing the whole volume: every bounding box overlaps every other one
+std::vector<ModelTriangle> generateSlivers(size_t triangleCount, unsigned int seed);
+
+// Builds a scene from a spec such as "sphere:1e5", "soup:10000", "cornell:1e6", "slivers:5000" or "cornell-box.obj".
+// Anything that isn't a generator name is loaded with readObjFile. Throws std::invalid_argument on a bad spec.
+std::vector<ModelTriangle> generateScene(const std::string &spec);
+// Same, as a shared mesh. OBJ files go through loadMesh, so they keep their own indices and textures.
+MeshHandle loadSceneMesh(const std::string &spec);
+
+// Writes triangles as an OBJ/MTL pair so generated scenes can be fed back through readObjFile.
+// Vertices are divided by scalingFactor, and written with enough digits to read back exactly, so reading the file
+// back with the same factor gives the same triangles up to the rounding of that division.
+void writeObjFile(const std::string &filename, const std::string &mtlFilename, const std::vector<ModelTriangle> &triangles, float scalingFactor);
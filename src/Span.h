@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Read-only view of contiguous items that someone else owns (C++14 has no std::span). Cheap to pass by value,
+// so functions that only read a triangle list take a Span instead of copying the vector.
+template <typename T>
+class Span {
+public:
+    Span() = default;
+    Span(const T *data, size_t size) : first(data), count(size) {}
+    Span(const std::vector<T> &items) : first(items.data()), count(items.size()) {}
+
+    const T *begin() const { return first; }
+    const T *end() const { return first + count; }
+    const T *data() const { return first; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T &operator[](size_t i) const { return first[i]; }
+
+private:
+    const T *first = nullptr;
+    size_t count = 0;
+};
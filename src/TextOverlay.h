@@ -0,0 +1,14 @@
+#pragma once
+
+#include <DrawingWindow.h>
+
+#define GLYPH_WIDTH 5
+#define GLYPH_HEIGHT 7
+
+// Draws `text` in a 5x7 pixel font with its top left corner at (x, y), each font pixel `scale` screen pixels wide.
+// Lower case letters are drawn as upper case, unknown characters as spaces and anything off screen is clipped.
+// Takes a C string because HUD lines are snprintf'd every frame and a std::string of that length would allocate.
+void drawText(DrawingWindow &window, int x, int y, const char *text, uint32_t colour, int scale = 1);
+
+// Halves the brightness of a rectangle so text drawn on top stays readable over any scene
+void darkenRect(DrawingWindow &window, int x, int y, int width, int height);
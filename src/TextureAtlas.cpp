@@ -0,0 +1,140 @@
+#include "TextureAtlas.h"
+#include "TextureSampler.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+
+size_t atlasTextureSize = 256;
+
+namespace {
+    struct Placement {
+        size_t texture;
+        size_t page;
+        size_t x;
+        size_t y;
+    };
+
+    size_t alignUp(size_t size, size_t alignment) {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    bool insideUnitSquare(const TexturePoint &point) {
+        const float epsilon = 1e-4f;
+        return point.x >= -epsilon && point.x <= 1 + epsilon && point.y >= -epsilon && point.y <= 1 + epsilon;
+    }
+}
+
+void packTextureAtlas(Mesh &mesh, size_t pageSize, size_t gutter) {
+    if (atlasTextureSize == 0 || mesh.textures.size() < 2) return;
+    std::vector<bool> candidate(mesh.textures.size(), true);
+    for (size_t i = 0; i < mesh.triangleTextures.size(); i++) {
+        int texture = mesh.triangleTextures[i];
+        if (texture < 0 || texture >= int(mesh.textures.size())) continue;
+        for (const TexturePoint &point : mesh.triangles[i].texturePoints) {
+            if (!insideUnitSquare(point)) candidate[texture] = false;
+        }
+    }
+    if (std::count(candidate.begin(), candidate.end(), true) < 2) return;
+    TraceScope trace("packTextureAtlas", "io");
+
+    // read straight from the files: the cache's copies may already be swizzled or compressed
+    std::vector<std::unique_ptr<TextureMap>> sources(mesh.textures.size());
+    std::vector<size_t> order;
+    for (size_t t = 0; t < mesh.textures.size(); t++) {
+        if (!candidate[t]) continue;
+        try {
+            sources[t].reset(new TextureMap(mesh.textures[t]->path));
+        } catch (const std::invalid_argument &) {
+            continue; // left to the cache, which draws the placeholder for it
+        }
+        size_t largest = std::max(sources[t]->width, sources[t]->height);
+        if (largest == 0 || largest > atlasTextureSize || largest + 4 * gutter > pageSize) sources[t].reset();
+        else order.push_back(t);
+    }
+    if (order.size() < 2) return;
+
+    // Positions are kept on multiples of the gutter (and of 4, for BC1 blocks), so every texture starts on a whole
+    // texel in each mip level the gutter still covers
+    size_t alignment = 4;
+    while (alignment < gutter) alignment *= 2;
+
+    // Shelf packing, tallest first: fill a row left to right, start a new row under the tallest in the last one,
+    // and a new page when a row doesn't fit
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sources[a]->height > sources[b]->height; });
+    std::vector<Placement> placements;
+    // pages only take up as much as their textures need
+    std::vector<size_t> pageWidths(1, 0), pageHeights(1, 0);
+    size_t x = 0, y = 0, shelfHeight = 0;
+    for (size_t t : order) {
+        size_t width = alignUp(sources[t]->width + 2 * gutter, alignment);
+        size_t height = alignUp(sources[t]->height + 2 * gutter, alignment);
+        if (x + width > pageSize) x = 0, y += shelfHeight, shelfHeight = 0;
+        if (y + height > pageSize) x = 0, y = 0, shelfHeight = 0, pageWidths.push_back(0), pageHeights.push_back(0);
+        placements.push_back({t, pageHeights.size() - 1, x, y});
+        pageWidths.back() = std::max(pageWidths.back(), x + width);
+        pageHeights.back() = std::max(pageHeights.back(), y + height);
+        shelfHeight = std::max(shelfHeight, height);
+        x += width;
+    }
+
+    std::vector<TextureMap> pages(pageHeights.size());
+    for (size_t p = 0; p < pages.size(); p++) {
+        pages[p].width = pageWidths[p];
+        pages[p].height = pageHeights[p];
+        pages[p].pixels.assign(pageWidths[p] * pageHeights[p], 0xFF000000);
+    }
+    for (const Placement &placement : placements) {
+        const TextureMap &source = *sources[placement.texture];
+        TextureMap &page = pages[placement.page];
+        // the gutter repeats the nearest edge texel
+        for (size_t row = 0; row < source.height + 2 * gutter; row++) {
+            size_t sourceY = std::min(row >= gutter ? row - gutter : 0, source.height - 1);
+            for (size_t column = 0; column < source.width + 2 * gutter; column++) {
+                size_t sourceX = std::min(column >= gutter ? column - gutter : 0, source.width - 1);
+                page.pixels[placement.x + column + (placement.y + row) * page.width] = source.pixels[sourceX + sourceY * source.width];
+            }
+        }
+    }
+
+    // Below the levels where the gutter is at least a texel wide, filtering would blend neighbouring textures in, so
+    // those levels are dropped: far away atlas textures alias a little instead
+    size_t levels = 1;
+    while (gutter >> levels) levels++;
+
+    // pages first, then the textures that weren't packed, then the virtual textures as before
+    std::vector<TextureRef> textures;
+    for (TextureMap &page : pages) {
+        page.buildMipmaps();
+        if (page.mipmaps.size() >= levels) page.mipmaps.resize(levels - 1);
+        applyTextureLayout(page, textureLayout);
+        textures.push_back(makeTexture("atlas", std::move(page)));
+    }
+    std::vector<int> remap(mesh.textures.size(), -1);
+    std::vector<const Placement *> placed(mesh.textures.size(), nullptr);
+    for (const Placement &placement : placements) {
+        remap[placement.texture] = int(placement.page);
+        placed[placement.texture] = &placement;
+    }
+    for (size_t t = 0; t < mesh.textures.size(); t++) {
+        if (placed[t]) continue;
+        remap[t] = int(textures.size());
+        textures.push_back(mesh.textures[t]);
+    }
+
+    for (size_t i = 0; i < mesh.triangleTextures.size(); i++) {
+        int &texture = mesh.triangleTextures[i];
+        if (texture < 0) continue;
+        if (texture >= int(mesh.textures.size())) {
+            texture += int(textures.size()) - int(mesh.textures.size());
+            continue;
+        }
+        if (const Placement *placement = placed[texture]) {
+            const TextureMap &source = *sources[texture];
+            for (TexturePoint &point : mesh.triangles[i].texturePoints) {
+                point.x = (placement->x + gutter + point.x * source.width) / pageWidths[placement->page];
+                point.y = (placement->y + gutter + point.y * source.height) / pageHeights[placement->page];
+            }
+        }
+        texture = remap[texture];
+    }
+    mesh.textures = std::move(textures);
+}
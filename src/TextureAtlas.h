@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Mesh.h"
+#include <cstddef>
+
+// Textures no bigger than this on either side are packed into atlases by readObjMesh; set with --texture-atlas N,
+// where 0 turns atlases off
+extern size_t atlasTextureSize;
+
+// Packs the mesh's small textures into shared pageSize x pageSize atlas pages and points the triangles using them
+// at the pages, rewriting their texturePoints to page coordinates. Every packed texture gets `gutter` texels of
+// its repeated edge around it, so filtering doesn't bleed neighbours in; pages only keep the mip levels where that
+// is still a texel or more (4 levels for 8). Only textures whose triangles keep to uvs inside [0, 1] are packed,
+// since an atlas can't repeat them, and only if there are at least two; their files are read on the calling thread.
+void packTextureAtlas(Mesh &mesh, size_t pageSize = 1024, size_t gutter = 8);
@@ -0,0 +1,218 @@
+#include "TextureCache.h"
+#include "JobSystem.h"
+#include "TextureSampler.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <map>
+#include <vector>
+
+namespace {
+    size_t textureBytes(const TextureMap &texture) {
+        size_t texels = texture.pixels.size();
+        for (const MipLevel &level : texture.mipmaps) texels += level.pixels.size();
+        return texels * sizeof(uint32_t);
+    }
+}
+
+class TextureCache {
+public:
+    // The cache outlives main but not the job system, whose workers may still be running its loads
+    ~TextureCache() {
+        wait();
+    }
+
+    TextureRef slot(const std::string &path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TextureRef &slot = slots[path];
+        if (!slot) slot = std::make_shared<TextureSlot>(path);
+        return slot;
+    }
+
+    uint64_t tick() {
+        return clock.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    // One job per texture; without worker threads it loads right away, on the thread that drew it
+    void enqueue(TextureSlot *slot) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending++;
+        }
+        jobs.submit([this, slot]() {
+            try {
+                load(*slot);
+            } catch (const std::exception &error) {
+                // `queued` stays set, so it isn't retried every frame
+                std::cerr << "Failed to load " << slot->path << ": " << error.what() << std::endl;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0) idle.notify_all();
+        });
+    }
+
+    // Reads the file unless it is already resident; throws like TextureMap's constructor
+    TextureHandle load(TextureSlot &slot) {
+        slot.lastUse = tick();
+        if (TextureHandle loaded = std::atomic_load(&slot.texture)) return loaded;
+        std::lock_guard<std::mutex> loading(slot.loading);
+        if (TextureHandle loaded = std::atomic_load(&slot.texture)) return loaded;
+        TraceScope trace("loadTexture", "io");
+        auto start = std::chrono::steady_clock::now();
+        std::shared_ptr<TextureMap> texture = std::make_shared<TextureMap>(slot.path);
+        applyTextureLayout(*texture, textureLayout);
+        // stderr, so it stays out of the benchmark's JSON on stdout
+        std::cerr << "Loaded " << slot.path << " " << *texture << " in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        install(slot, texture);
+        loads++;
+        return texture;
+    }
+
+    // Not kept in `slots`: the slot lives as long as the TextureRefs to it, and leaves the cache with the last one
+    TextureRef add(const std::string &name, TextureMap texture) {
+        std::lock_guard<std::mutex> lock(mutex);
+        // a number keeps every call's slot separate, even for the same name
+        TextureRef slot(new TextureSlot(name + " #" + std::to_string(made++)), [this](TextureSlot *slot) {
+            release(*slot);
+            delete slot;
+        });
+        slot->pinned = true;
+        slot->queued = true;
+        install(*slot, std::make_shared<const TextureMap>(std::move(texture)));
+        return slot;
+    }
+
+    void setBudget(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        budget = bytes;
+        evict(nullptr);
+    }
+
+    TextureCacheStats stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return {residentBytes, resident.size(), pending, loads, evictions};
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this]() { return pending == 0; });
+    }
+
+private:
+    // Drops a slot made by add, for good
+    void release(TextureSlot &slot) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto entry = std::find(resident.begin(), resident.end(), &slot);
+        if (entry == resident.end()) return;
+        residentBytes -= slot.bytes;
+        resident.erase(entry);
+    }
+
+    // Needs `mutex`
+    void install(TextureSlot &slot, TextureHandle texture) {
+        slot.bytes = textureBytes(*texture);
+        slot.lastUse = tick();
+        std::atomic_store(&slot.texture, texture);
+        resident.push_back(&slot);
+        residentBytes += slot.bytes;
+        evict(&slot);
+    }
+
+    // Drops the least recently used textures, except `keep` and pinned ones, until the resident ones fit the
+    // budget. Needs `mutex`.
+    void evict(const TextureSlot *keep) {
+        while (residentBytes > budget) {
+            auto victim = resident.end();
+            for (auto candidate = resident.begin(); candidate != resident.end(); ++candidate) {
+                if (*candidate == keep || (*candidate)->pinned) continue;
+                if (victim == resident.end() || (*candidate)->lastUse < (*victim)->lastUse) victim = candidate;
+            }
+            if (victim == resident.end()) return;
+            TextureSlot *slot = *victim;
+            std::atomic_store(&slot->texture, TextureHandle());
+            slot->queued = false;
+            residentBytes -= slot->bytes;
+            resident.erase(victim);
+            evictions++;
+        }
+    }
+
+    std::mutex mutex;
+    std::map<std::string, TextureRef> slots;
+    std::vector<TextureSlot *> resident;
+    size_t residentBytes = 0;
+    size_t budget = size_t(512) << 20;
+    uint64_t loads = 0;
+    uint64_t evictions = 0;
+    // slots made by add, for their names
+    uint64_t made = 0;
+    std::atomic<uint64_t> clock{0};
+
+    // load jobs submitted and not yet finished
+    size_t pending = 0;
+    std::condition_variable idle;
+};
+
+namespace {
+    TextureCache &cache() {
+        static TextureCache cache;
+        return cache;
+    }
+}
+
+TextureSlot::TextureSlot(std::string path) : path(std::move(path)) {}
+
+TextureHandle TextureSlot::get() const {
+    lastUse.store(cache().tick(), std::memory_order_relaxed);
+    if (TextureHandle loaded = std::atomic_load(&texture)) return loaded;
+    if (!queued.exchange(true)) cache().enqueue(const_cast<TextureSlot *>(this));
+    return placeholderTexture();
+}
+
+bool TextureSlot::resident() const {
+    return std::atomic_load(&texture) != nullptr;
+}
+
+TextureRef requestTexture(const std::string &path) {
+    return cache().slot(path);
+}
+
+TextureHandle loadTexture(const std::string &path) {
+    return cache().load(*cache().slot(path));
+}
+
+TextureRef makeTexture(const std::string &name, TextureMap texture) {
+    return cache().add(name, std::move(texture));
+}
+
+TextureHandle placeholderTexture() {
+    static TextureHandle placeholder = []() {
+        // 8x8 checks, 8 texels each
+        auto texture = std::make_shared<TextureMap>();
+        texture->width = texture->height = 64;
+        texture->pixels.resize(64 * 64);
+        for (size_t y = 0; y < 64; y++) {
+            for (size_t x = 0; x < 64; x++) texture->pixels[x + y * 64] = (x / 8 + y / 8) % 2 ? 0xFF808080 : 0xFFC0C0C0;
+        }
+        texture->buildMipmaps();
+        return TextureHandle(texture);
+    }();
+    return placeholder;
+}
+
+void setTextureBudget(size_t bytes) {
+    cache().setBudget(bytes);
+}
+
+TextureCacheStats textureCacheStats() {
+    return cache().stats();
+}
+
+void waitForTextures() {
+    cache().wait();
+}
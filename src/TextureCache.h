@@ -0,0 +1,69 @@
+#pragma once
+
+#include <TextureMap.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Immutable, shared texture storage
+using TextureHandle = std::shared_ptr<const TextureMap>;
+
+// One texture file in the cache. It is loaded by a job on the job system the first time it is drawn, and
+// can be evicted again (and reloaded the next time it is drawn) to keep the cache inside its memory budget.
+// Slots for files live until the program exits, so there is exactly one per path; slots from makeTexture leave the
+// cache with the last TextureRef to them.
+class TextureSlot {
+public:
+    explicit TextureSlot(std::string path);
+    const std::string path;
+
+    // The texture if it is loaded, otherwise placeholderTexture() and a load is queued. Every call counts as a use
+    // for the LRU eviction, so draw code looks each texture up once per frame and keeps the handle until it is done.
+    TextureHandle get() const;
+    bool resident() const;
+
+private:
+    friend class TextureCache;
+    // only accessed with std::atomic_load / std::atomic_store, a load job fills it in while frames are drawn
+    TextureHandle texture;
+    size_t bytes = 0;
+    // made in memory by makeTexture, so there is no file to reload it from after an eviction
+    bool pinned = false;
+    mutable std::atomic<uint64_t> lastUse{0};
+    mutable std::atomic<bool> queued{false};
+    // held while loading, so a load job and loadTexture never read the same file at the same time
+    std::mutex loading;
+};
+
+using TextureRef = std::shared_ptr<TextureSlot>;
+
+struct TextureCacheStats {
+    size_t residentBytes;
+    size_t residentTextures;
+    size_t pendingLoads;
+    uint64_t loads;
+    uint64_t evictions;
+};
+
+// The slot for `path`; nothing is read until it is drawn (see TextureSlot::get)
+TextureRef requestTexture(const std::string &path);
+// The texture at `path`, loaded on the calling thread if it isn't resident. Throws std::invalid_argument if the
+// file can't be read, where a background load would only print the error and keep drawing the placeholder.
+TextureHandle loadTexture(const std::string &path);
+// Puts a texture built in memory (e.g. an atlas page) in the cache under a new slot. It counts towards the budget
+// and is never evicted, but is dropped once the returned slot and every copy of it are gone (e.g. with the mesh
+// that holds it).
+TextureRef makeTexture(const std::string &name, TextureMap texture);
+// Grey checkerboard drawn in place of textures that are still loading (or failed to)
+TextureHandle placeholderTexture();
+
+// Once resident textures (with their mipmaps) take more than this, the least recently drawn ones are evicted.
+// Textures still held by a handle stay alive until the handle goes, they just stop being cached. Default 512 MB,
+// set with --texture-budget MB.
+void setTextureBudget(size_t bytes);
+TextureCacheStats textureCacheStats();
+// Blocks until every queued load has finished, e.g. so a benchmark doesn't time the placeholder
+void waitForTextures();
@@ -0,0 +1,290 @@
+#include "TextureSampler.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+TextureLayout textureLayout = LAYOUT_LINEAR;
+
+namespace {
+    struct Level {
+        size_t width;
+        size_t height;
+        const uint32_t *pixels;
+        bool swizzled;
+        bool compressed;
+        size_t blocksPerRow;
+    };
+
+    Level level(const TextureMap &texture, size_t index) {
+        if (index == 0) return {texture.width, texture.height, texture.pixels.data(), texture.swizzled, texture.compressed, (texture.width + 3) / 4};
+        const MipLevel &mip = texture.mipmaps[std::min(index, texture.mipmaps.size()) - 1];
+        return {mip.width, mip.height, mip.pixels.data(), texture.swizzled, texture.compressed, (mip.width + 3) / 4};
+    }
+
+    // repeat addressing, also for negative coordinates. Only coordinates outside the texture need wrapping, and
+    // power of two sizes (every level of a power of two texture) take a mask instead of a division.
+    size_t wrap(int coordinate, size_t size) {
+        if (size_t(coordinate) < size) return size_t(coordinate);
+        if ((size & (size - 1)) == 0) return size_t(coordinate) & (size - 1);
+        int wrapped = coordinate % int(size);
+        return wrapped < 0 ? wrapped + size : wrapped;
+    }
+
+    // Block index times 16, plus the Morton code of (x, y) inside the block: bits x0 y0 x1 y1 from low to high
+    size_t swizzledIndex(size_t blocksPerRow, size_t x, size_t y) {
+        size_t block = y / 4 * blocksPerRow + x / 4;
+        size_t inBlock = (x & 1) | (y & 1) << 1 | (x & 2) << 1 | (y & 2) << 2;
+        return block << 4 | inBlock;
+    }
+
+    uint32_t expand565(uint32_t colour) {
+        uint32_t red = colour >> 11, green = (colour >> 5) & 63, blue = colour & 31;
+        return (255u << 24) | (red << 3 | red >> 2) << 16 | (green << 2 | green >> 4) << 8 | (blue << 3 | blue >> 2);
+    }
+
+    uint32_t to565(glm::vec3 colour) {
+        glm::vec3 clamped = glm::clamp(colour, 0.0f, 255.0f);
+        return uint32_t(clamped.r * 31 / 255 + 0.5f) << 11 | uint32_t(clamped.g * 63 / 255 + 0.5f) << 5 | uint32_t(clamped.b * 31 / 255 + 0.5f);
+    }
+
+    glm::vec3 channels(uint32_t texel) {
+        return glm::vec3((texel >> 16) & 0xFF, (texel >> 8) & 0xFF, texel & 0xFF);
+    }
+
+    // Word 0 of a block is the end colours (c0 | c1 << 16), word 1 the 2 bit indices, texel (0, 0) in the low bits
+    void bc1Palette(uint32_t ends, uint32_t *palette) {
+        uint32_t c0 = ends & 0xFFFF, c1 = ends >> 16;
+        palette[0] = expand565(c0);
+        palette[1] = expand565(c1);
+        // BC1's three colour mode (c0 <= c1) has black as the fourth; compressTexture only makes it when c0 == c1
+        palette[2] = c0 > c1 ? blendTexels(palette[0], palette[1], 1 / 3.0f) : blendTexels(palette[0], palette[1], 0.5f);
+        palette[3] = c0 > c1 ? blendTexels(palette[0], palette[1], 2 / 3.0f) : 0xFF000000;
+    }
+
+    // Recently decoded blocks, per thread. Keyed by the block's 8 bytes rather than its address, since decoding
+    // depends on nothing else, so a texture being freed and another loaded in its place can't return stale texels.
+    struct DecodedBlock {
+        uint64_t block = 0;
+        uint32_t texels[16];
+        DecodedBlock() {
+            uint32_t palette[4];
+            bc1Palette(0, palette);
+            std::fill(texels, texels + 16, palette[0]);
+        }
+    };
+    thread_local DecodedBlock decodedBlocks[256];
+
+    uint32_t compressedTexel(const Level &level, size_t x, size_t y) {
+        const uint32_t *words = level.pixels + 2 * (y / 4 * level.blocksPerRow + x / 4);
+        uint64_t block = words[0] | uint64_t(words[1]) << 32;
+        DecodedBlock &decoded = decodedBlocks[(block * 0x9E3779B97F4A7C15ull) >> 56];
+        if (decoded.block != block) {
+            uint32_t palette[4];
+            bc1Palette(words[0], palette);
+            for (size_t i = 0; i < 16; i++) decoded.texels[i] = palette[(words[1] >> (2 * i)) & 3];
+            decoded.block = block;
+        }
+        return decoded.texels[(y & 3) * 4 + (x & 3)];
+    }
+
+    // (x, y) already wrapped into the level
+    uint32_t wrappedTexel(const Level &level, size_t x, size_t y) {
+        if (level.swizzled) return level.pixels[swizzledIndex(level.blocksPerRow, x, y)];
+        if (level.compressed) return compressedTexel(level, x, y);
+        return level.pixels[x + y * level.width];
+    }
+
+    uint32_t texel(const Level &level, int x, int y) {
+        return wrappedTexel(level, wrap(x, level.width), wrap(y, level.height));
+    }
+
+    // Picks every texel's nearest palette colour for the end colours c0 and c1, returning the squared error
+    float encodeIndices(const glm::vec3 *colours, uint32_t c0, uint32_t c1, uint32_t *words) {
+        if (c0 < c1) std::swap(c0, c1);
+        words[0] = c0 | c1 << 16;
+        words[1] = 0;
+        uint32_t palette[4];
+        bc1Palette(words[0], palette);
+        float error = 0;
+        for (size_t i = 0; i < 16; i++) {
+            // equal ends are the three colour mode, where index 3 is black
+            size_t nearest = 0;
+            float nearestDistance = FLT_MAX;
+            for (size_t p = 0; p < (c0 == c1 ? 1 : 4); p++) {
+                glm::vec3 difference = colours[i] - channels(palette[p]);
+                float distance = glm::dot(difference, difference);
+                if (distance < nearestDistance) nearestDistance = distance, nearest = p;
+            }
+            words[1] |= uint32_t(nearest) << (2 * i);
+            error += nearestDistance;
+        }
+        return error;
+    }
+
+    // First guess: end colours along the bounding box diagonal that best follows the block's colours (found from
+    // the signs of the red-green and red-blue covariances), inset by 1/16 of the box. Then one least squares fit of
+    // the end colours to the indices that guess chose, kept if it has less error (it gets two colour blocks exact).
+    void compressBlock(const uint32_t *texels, uint32_t *words) {
+        glm::vec3 colours[16], mean(0);
+        for (size_t i = 0; i < 16; i++) mean += colours[i] = channels(texels[i]);
+        mean /= 16.0f;
+        glm::vec3 low(255), high(0);
+        float redGreen = 0, redBlue = 0;
+        for (const glm::vec3 &colour : colours) {
+            low = glm::min(low, colour);
+            high = glm::max(high, colour);
+            redGreen += (colour.r - mean.r) * (colour.g - mean.g);
+            redBlue += (colour.r - mean.r) * (colour.b - mean.b);
+        }
+        glm::vec3 inset = (high - low) / 16.0f;
+        low += inset;
+        high -= inset;
+        if (redGreen < 0) std::swap(low.g, high.g);
+        if (redBlue < 0) std::swap(low.b, high.b);
+
+        float error = encodeIndices(colours, to565(high), to565(low), words);
+        if (error == 0 || (words[0] & 0xFFFF) == words[0] >> 16) return;
+
+        // texel i is weight * c0 + (1 - weight) * c1
+        static const float weights[4] = {1, 0, 2 / 3.0f, 1 / 3.0f};
+        float aa = 0, ab = 0, bb = 0;
+        glm::vec3 ax(0), bx(0);
+        for (size_t i = 0; i < 16; i++) {
+            float a = weights[(words[1] >> (2 * i)) & 3], b = 1 - a;
+            aa += a * a, ab += a * b, bb += b * b;
+            ax += a * colours[i], bx += b * colours[i];
+        }
+        float determinant = aa * bb - ab * ab;
+        if (determinant == 0) return;
+        uint32_t fitted[2];
+        float fittedError = encodeIndices(colours, to565((ax * bb - bx * ab) / determinant), to565((bx * aa - ax * ab) / determinant), fitted);
+        if (fittedError < error) words[0] = fitted[0], words[1] = fitted[1];
+    }
+
+    // Blocks in row order; the edge blocks of sizes that aren't a multiple of 4 repeat the last row and column
+    std::vector<uint32_t> compress(const std::vector<uint32_t> &pixels, size_t width, size_t height) {
+        size_t blocksPerRow = (width + 3) / 4;
+        std::vector<uint32_t> blocks(blocksPerRow * ((height + 3) / 4) * 2);
+        uint32_t texels[16];
+        for (size_t blockY = 0; blockY < (height + 3) / 4; blockY++) {
+            for (size_t blockX = 0; blockX < blocksPerRow; blockX++) {
+                for (size_t i = 0; i < 16; i++) {
+                    size_t x = std::min(blockX * 4 + i % 4, width - 1), y = std::min(blockY * 4 + i / 4, height - 1);
+                    texels[i] = pixels[x + y * width];
+                }
+                compressBlock(texels, &blocks[2 * (blockX + blockY * blocksPerRow)]);
+            }
+        }
+        return blocks;
+    }
+
+    // Padded up to whole blocks; the padding is never read since addressing wraps first
+    std::vector<uint32_t> swizzle(const std::vector<uint32_t> &pixels, size_t width, size_t height) {
+        std::vector<uint32_t> swizzled((width + 3) / 4 * ((height + 3) / 4) * 16);
+        for (size_t y = 0; y < height; y++) {
+            for (size_t x = 0; x < width; x++) swizzled[swizzledIndex((width + 3) / 4, x, y)] = pixels[x + y * width];
+        }
+        return swizzled;
+    }
+}
+
+const char *textureFilterName(TextureFilter filter) {
+    static const char *names[FILTER_COUNT] = {"nearest", "bilinear", "trilinear"};
+    return names[filter];
+}
+
+TextureFilter parseTextureFilter(const std::string &name) {
+    for (int filter = 0; filter < FILTER_COUNT; filter++) {
+        if (name == textureFilterName(TextureFilter(filter))) return TextureFilter(filter);
+    }
+    throw std::invalid_argument("Unknown texture filter `" + name + "`, expected nearest, bilinear or trilinear");
+}
+
+const char *textureLayoutName(TextureLayout layout) {
+    static const char *names[LAYOUT_COUNT] = {"linear", "swizzled", "bc1"};
+    return names[layout];
+}
+
+TextureLayout parseTextureLayout(const std::string &name) {
+    for (int layout = 0; layout < LAYOUT_COUNT; layout++) {
+        if (name == textureLayoutName(TextureLayout(layout))) return TextureLayout(layout);
+    }
+    throw std::invalid_argument("Unknown texture layout `" + name + "`, expected linear, swizzled or bc1");
+}
+
+void swizzleTexture(TextureMap &texture) {
+    if (texture.swizzled || texture.compressed) return;
+    texture.pixels = swizzle(texture.pixels, texture.width, texture.height);
+    for (MipLevel &mip : texture.mipmaps) mip.pixels = swizzle(mip.pixels, mip.width, mip.height);
+    texture.swizzled = true;
+}
+
+void compressTexture(TextureMap &texture) {
+    if (texture.swizzled || texture.compressed) return;
+    texture.pixels = compress(texture.pixels, texture.width, texture.height);
+    for (MipLevel &mip : texture.mipmaps) mip.pixels = compress(mip.pixels, mip.width, mip.height);
+    texture.compressed = true;
+}
+
+void applyTextureLayout(TextureMap &texture, TextureLayout layout) {
+    if (layout == LAYOUT_SWIZZLED) swizzleTexture(texture);
+    else if (layout == LAYOUT_BC1) compressTexture(texture);
+}
+
+uint32_t fetchTexel(const TextureMap &texture, size_t index, int x, int y) {
+    return texel(level(texture, index), x, y);
+}
+
+uint32_t sampleTexture(const TextureMap &texture, glm::vec2 uv) {
+    return sampleNearest(texture, 0, uv);
+}
+
+uint32_t sampleNearest(const TextureMap &texture, size_t index, glm::vec2 uv) {
+    Level l = level(texture, index);
+    return texel(l, int(std::floor(uv.x * l.width)), int(std::floor(uv.y * l.height)));
+}
+
+uint32_t sampleBilinear(const TextureMap &texture, size_t index, glm::vec2 uv) {
+    Level l = level(texture, index);
+    // texel centres sit at half integers
+    float x = uv.x * l.width - 0.5f;
+    float y = uv.y * l.height - 0.5f;
+    float floorX = std::floor(x);
+    float floorY = std::floor(y);
+    float fx = x - floorX;
+    float fy = y - floorY;
+    // the footprint is wrapped once: its second column and row are the next ones round
+    size_t x0 = wrap(int(floorX), l.width), y0 = wrap(int(floorY), l.height);
+    size_t x1 = x0 + 1 == l.width ? 0 : x0 + 1, y1 = y0 + 1 == l.height ? 0 : y0 + 1;
+    uint32_t top = blendTexels(wrappedTexel(l, x0, y0), wrappedTexel(l, x1, y0), fx);
+    uint32_t bottom = blendTexels(wrappedTexel(l, x0, y1), wrappedTexel(l, x1, y1), fx);
+    return blendTexels(top, bottom, fy);
+}
+
+uint32_t sampleTrilinear(const TextureMap &texture, glm::vec2 uv, float lod) {
+    if (lod <= 0) return sampleBilinear(texture, 0, uv);
+    size_t finer = size_t(lod);
+    if (finer + 1 >= texture.levels()) return sampleBilinear(texture, texture.levels() - 1, uv);
+    return blendTexels(sampleBilinear(texture, finer, uv), sampleBilinear(texture, finer + 1, uv), lod - finer);
+}
+
+float mipLevel(const TextureMap &texture, glm::vec2 uvPerPixelX, glm::vec2 uvPerPixelY) {
+    glm::vec2 size(texture.width, texture.height);
+    glm::vec2 texelsX = uvPerPixelX * size, texelsY = uvPerPixelY * size;
+    // log2 of the squared length, halved, rather than a square root per axis
+    float texelsPerPixelSquared = std::max(glm::dot(texelsX, texelsX), glm::dot(texelsY, texelsY));
+    if (texelsPerPixelSquared <= 1) return 0;
+    return std::min(0.5f * std::log2(texelsPerPixelSquared), float(texture.levels() - 1));
+}
+
+uint32_t sampleTexture(const TextureMap &texture, glm::vec2 uv, glm::vec2 uvPerPixelX, glm::vec2 uvPerPixelY, TextureFilter filter) {
+    if (filter == FILTER_NEAREST) return sampleTexture(texture, uv);
+    return sampleTexture(texture, uv, mipLevel(texture, uvPerPixelX, uvPerPixelY), filter);
+}
+
+uint32_t sampleTexture(const TextureMap &texture, glm::vec2 uv, float lod, TextureFilter filter) {
+    if (filter == FILTER_NEAREST) return sampleTexture(texture, uv);
+    if (filter == FILTER_BILINEAR) return sampleBilinear(texture, size_t(lod + 0.5f), uv);
+    return sampleTrilinear(texture, uv, lod);
+}
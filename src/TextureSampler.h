@@ -0,0 +1,70 @@
+#pragma once
+
+#include <TextureMap.h>
+#include <glm/glm.hpp>
+#include <string>
+
+// Texture coordinates are in [0, 1] with (0, 0) the top left texel, and repeat outside that range
+enum TextureFilter {
+    FILTER_NEAREST,    // nearest texel of the full size level, no mipmapping
+    FILTER_BILINEAR,   // bilinear within the closest mip level
+    FILTER_TRILINEAR,  // bilinear in the two closest mip levels, blended
+    FILTER_COUNT
+};
+
+// How texels are laid out in memory. Swizzled textures store each 4x4 block of texels in one 64 byte cache line,
+// in Morton (Z) order inside the block and blocks in row order, so a sample and its neighbours in any direction
+// usually share a cache line. Row order only keeps horizontal neighbours together. BC1 textures are compressed to
+// 4 bits per texel (8x smaller, lossy) and decoded a block at a time while sampling.
+enum TextureLayout {
+    LAYOUT_LINEAR,
+    LAYOUT_SWIZZLED,
+    LAYOUT_BC1,
+    LAYOUT_COUNT
+};
+
+// Layout loadTexture gives new textures, set with --texture-layout; textures already loaded keep theirs
+extern TextureLayout textureLayout;
+
+const char *textureLayoutName(TextureLayout layout);
+// Throws std::invalid_argument for anything but linear, swizzled or bc1
+TextureLayout parseTextureLayout(const std::string &name);
+// Rearranges every level of a linear texture into the swizzled layout
+void swizzleTexture(TextureMap &texture);
+// Encodes every level of a linear texture as BC1 blocks: two 565 end colours and a 2 bit index per texel choosing
+// between them and the two colours a third and two thirds of the way between
+void compressTexture(TextureMap &texture);
+// Converts a freshly loaded (linear) texture to `layout`
+void applyTextureLayout(TextureMap &texture, TextureLayout layout);
+
+const char *textureFilterName(TextureFilter filter);
+// Throws std::invalid_argument for anything but nearest, bilinear or trilinear
+TextureFilter parseTextureFilter(const std::string &name);
+
+// Opaque a * (1 - t) + b * t, t in [0, 1] as 8 bit fixed point; red and blue are blended in one multiply, green
+// in another
+inline uint32_t blendTexels(uint32_t a, uint32_t b, float t) {
+    uint32_t weight = uint32_t(t * 256 + 0.5f);
+    uint32_t redBlue = (((a & 0xFF00FF) * (256 - weight) + (b & 0xFF00FF) * weight + 0x800080) >> 8) & 0xFF00FF;
+    uint32_t green = (((a & 0x00FF00) * (256 - weight) + (b & 0x00FF00) * weight + 0x008000) >> 8) & 0x00FF00;
+    return (255u << 24) | redBlue | green;
+}
+
+// Texel (x, y) of mip `level` in either layout, repeating outside the texture
+uint32_t fetchTexel(const TextureMap &texture, size_t level, int x, int y);
+// Nearest texel of the full size level
+uint32_t sampleTexture(const TextureMap &texture, glm::vec2 uv);
+// Nearest texel of mip `level` (0 is the full size texture)
+uint32_t sampleNearest(const TextureMap &texture, size_t level, glm::vec2 uv);
+uint32_t sampleBilinear(const TextureMap &texture, size_t level, glm::vec2 uv);
+// lod is a fractional mip level, see mipLevel
+uint32_t sampleTrilinear(const TextureMap &texture, glm::vec2 uv, float lod);
+
+// log2 of how many texels one screen pixel covers, given how far uv moves per pixel along screen x and y.
+// 0 or less means magnification (the full size level), clamped to the smallest level at the other end.
+float mipLevel(const TextureMap &texture, glm::vec2 uvPerPixelX, glm::vec2 uvPerPixelY);
+
+// Samples with `filter`, choosing the mip level from the screen space derivatives when the filter uses one
+uint32_t sampleTexture(const TextureMap &texture, glm::vec2 uv, glm::vec2 uvPerPixelX, glm::vec2 uvPerPixelY, TextureFilter filter);
+// Same, at a mip level already worked out with mipLevel, for callers that share one between neighbouring pixels
+uint32_t sampleTexture(const TextureMap &texture, glm::vec2 uv, float lod, TextureFilter filter);
@@ -0,0 +1,98 @@
+#include "TraceRecorder.h"
+#include <fstream>
+
+TraceRecorder tracer;
+
+TraceRecorder::TraceRecorder() : recording(false), epoch(std::chrono::steady_clock::now()) {}
+
+void TraceRecorder::start() {
+    recording = true;
+}
+
+void TraceRecorder::stop() {
+    recording = false;
+    stopTime = now();
+}
+
+double TraceRecorder::now() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+TraceThread &TraceRecorder::thread() {
+    thread_local TraceThread *local = nullptr;
+    if (!local) {
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.emplace_back(new TraceThread());
+        local = threads.back().get();
+        local->id = uint32_t(threads.size());
+    }
+    return *local;
+}
+
+void TraceRecorder::begin(const char *name, const char *category, TraceArg first, TraceArg second) {
+    if (!enabled()) return;
+    thread().events.push_back({name, category, 'B', now(), {first, second}});
+}
+
+void TraceRecorder::end(const char *name, const char *category) {
+    if (!enabled()) return;
+    thread().events.push_back({name, category, 'E', now(), {}});
+}
+
+void TraceRecorder::setThreadName(const std::string &name) {
+    TraceThread &current = thread();
+    std::lock_guard<std::mutex> lock(mutex);
+    // thread ids handed out by thread() are 1..threads.size(), named ones start far above them
+    auto found = threadIds.find(name);
+    if (found == threadIds.end()) found = threadIds.emplace(name, uint32_t(100000 + threadIds.size())).first;
+    current.id = found->second;
+}
+
+const char *TraceRecorder::intern(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return names.insert(name).first->c_str();
+}
+
+void TraceRecorder::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &traceThread : threads) traceThread->events.clear();
+}
+
+void TraceRecorder::writeJson(const std::string &filename) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ofstream json(filename);
+    json.precision(15);
+    json << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    for (const auto &name : threadIds) {
+        json << (first ? "" : ",\n") << "{\"ph\": \"M\", \"pid\": 1, \"tid\": " << name.second
+             << ", \"name\": \"thread_name\", \"args\": {\"name\": \"" << name.first << "\"}}";
+        first = false;
+    }
+    auto write = [&](const TraceEvent &event, uint32_t tid) {
+        json << (first ? "" : ",\n") << "{\"ph\": \"" << event.phase << "\", \"pid\": 1, \"tid\": " << tid
+             << ", \"ts\": " << event.timestamp << ", \"name\": \"" << event.name << "\", \"cat\": \"" << event.category << "\"";
+        if (event.args[0].name) {
+            json << ", \"args\": {\"" << event.args[0].name << "\": " << event.args[0].value;
+            if (event.args[1].name) json << ", \"" << event.args[1].name << "\": " << event.args[1].value;
+            json << "}";
+        }
+        json << "}";
+        first = false;
+    };
+    for (const auto &traceThread : threads) {
+        // scopes nest on a thread, so an 'E' ends the innermost open 'B'
+        std::vector<const TraceEvent *> open;
+        for (const TraceEvent &event : traceThread->events) {
+            if (event.phase == 'E') {
+                if (open.empty()) continue;
+                open.pop_back();
+            } else {
+                open.push_back(&event);
+            }
+            write(event, traceThread->id);
+        }
+        for (size_t i = open.size(); i-- > 0;) write({open[i]->name, open[i]->category, 'E', stopTime, {}}, traceThread->id);
+    }
+    json << "\n]}\n";
+}
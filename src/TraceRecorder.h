@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// Records begin/end events from any thread and writes them as Chrome trace-event JSON, which can be opened in
+// Perfetto (ui.perfetto.dev) or chrome://tracing. While recording is off, TraceScope only checks a flag.
+
+struct TraceArg {
+    const char *name = nullptr;
+    int64_t value = 0;
+};
+
+struct TraceEvent {
+    const char *name;     // must be a string literal (or otherwise outlive the recorder)
+    const char *category;
+    char phase;           // 'B' begin, 'E' end
+    double timestamp;     // microseconds since the recorder was created
+    TraceArg args[2];
+};
+
+struct TraceThread {
+    uint32_t id;
+    std::vector<TraceEvent> events;
+};
+
+class TraceRecorder {
+public:
+    TraceRecorder();
+    void start();
+    void stop();
+    bool enabled() const { return recording.load(std::memory_order_relaxed); }
+    void begin(const char *name, const char *category, TraceArg first = TraceArg(), TraceArg second = TraceArg());
+    void end(const char *name, const char *category);
+    // Events from every thread given the same name end up on the same track, e.g. "worker 2" across benchmark runs
+    void setThreadName(const std::string &name);
+    // Returns a copy of `name` that lives as long as the recorder, for event names built at run time
+    const char *intern(const std::string &name);
+    // clear and writeJson read every thread's events, so only call them once recording has stopped
+    void clear();
+    // Every 'B' gets an 'E': scopes still open at stop() are ended there, and ends of scopes begun before the last
+    // clear() are left out
+    void writeJson(const std::string &filename);
+
+private:
+    TraceThread &thread();
+    double now() const;
+
+    std::atomic<bool> recording;
+    std::chrono::steady_clock::time_point epoch;
+    // when stop() was last called, which writeJson ends scopes still open then at
+    double stopTime = 0;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceThread>> threads;
+    std::map<std::string, uint32_t> threadIds;
+    std::set<std::string> names;
+};
+
+extern TraceRecorder tracer;
+
+class TraceScope {
+public:
+    TraceScope(const char *name, const char *category, TraceArg first = TraceArg(), TraceArg second = TraceArg())
+            : name(name), category(category), active(tracer.enabled()) {
+        if (active) tracer.begin(name, category, first, second);
+    }
+    ~TraceScope() {
+        if (active) tracer.end(name, category);
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *name;
+    const char *category;
+    bool active;
+};
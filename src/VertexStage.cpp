@@ -0,0 +1,56 @@
+#include "VertexStage.h"
+#include "Renderer.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+    CanvasPoint projectVertex(const glm::vec4 &position, const glm::vec3 &cameraPosition, const glm::mat3 &orientation, float focalLength, float range) {
+        glm::vec3 distanceVec = (cameraPosition - glm::vec3(position)) * orientation;
+        float a = focalLength * (distanceVec.x / -distanceVec.z);
+        float b = focalLength * (distanceVec.y / distanceVec.z);
+        return CanvasPoint(a * range + WIDTH/2, b * range + HEIGHT/2, distanceVec.z);
+    }
+}
+
+void projectVertices(const std::vector<glm::vec4> &positions, CanvasPoint *projected,
+                     const glm::vec3 &cameraPosition, const glm::mat3 &orientation, float focalLength, float range) {
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128 camX = _mm_set1_ps(cameraPosition.x), camY = _mm_set1_ps(cameraPosition.y), camZ = _mm_set1_ps(cameraPosition.z);
+    // v * m in glm dots v with each column of m
+    __m128 m[3][3];
+    for (int column = 0; column < 3; column++) {
+        for (int row = 0; row < 3; row++) m[column][row] = _mm_set1_ps(orientation[column][row]);
+    }
+    __m128 focal = _mm_set1_ps(focalLength), scale = _mm_set1_ps(range);
+    __m128 centreX = _mm_set1_ps(WIDTH/2), centreY = _mm_set1_ps(HEIGHT/2);
+    __m128 signBit = _mm_set1_ps(-0.0f);
+
+    alignas(16) float xs[4], ys[4], zs[4];
+    for (; i + 4 <= positions.size(); i += 4) {
+        // four xyzw vertices in, one register each of x, y, z (and w) out
+        __m128 x = _mm_loadu_ps(&positions[i][0]);
+        __m128 y = _mm_loadu_ps(&positions[i + 1][0]);
+        __m128 z = _mm_loadu_ps(&positions[i + 2][0]);
+        __m128 w = _mm_loadu_ps(&positions[i + 3][0]);
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+
+        __m128 dx = _mm_sub_ps(camX, x), dy = _mm_sub_ps(camY, y), dz = _mm_sub_ps(camZ, z);
+        __m128 vx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, m[0][0]), _mm_mul_ps(dy, m[0][1])), _mm_mul_ps(dz, m[0][2]));
+        __m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, m[1][0]), _mm_mul_ps(dy, m[1][1])), _mm_mul_ps(dz, m[1][2]));
+        __m128 vz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, m[2][0]), _mm_mul_ps(dy, m[2][1])), _mm_mul_ps(dz, m[2][2]));
+
+        // a full divide rather than _mm_rcp_ps, so the result matches getCanvasIntersectionPoint
+        __m128 a = _mm_mul_ps(focal, _mm_div_ps(vx, _mm_xor_ps(vz, signBit)));
+        __m128 b = _mm_mul_ps(focal, _mm_div_ps(vy, vz));
+        _mm_store_ps(xs, _mm_add_ps(_mm_mul_ps(a, scale), centreX));
+        _mm_store_ps(ys, _mm_add_ps(_mm_mul_ps(b, scale), centreY));
+        _mm_store_ps(zs, vz);
+        for (int k = 0; k < 4; k++) projected[i + k] = CanvasPoint(xs[k], ys[k], zs[k]);
+    }
+#endif
+    for (; i < positions.size(); i++) {
+        projected[i] = projectVertex(positions[i], cameraPosition, orientation, focalLength, range);
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <CanvasPoint.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Projects every position into canvas space, the batched equivalent of calling getCanvasIntersectionPoint on
+// each one. `projected` needs room for positions.size() points (the renderer takes it from the frame arena).
+// Four vertices go through at a time with SSE when the compiler targets it, the remainder (or everything on
+// other targets) takes the scalar path.
+void projectVertices(const std::vector<glm::vec4> &positions, CanvasPoint *projected,
+                     const glm::vec3 &cameraPosition, const glm::mat3 &orientation, float focalLength, float range);
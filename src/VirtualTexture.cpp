@@ -0,0 +1,391 @@
+#include "VirtualTexture.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <stdexcept>
+
+namespace {
+    // File layout: six uint32s (magic, version, width, height, page size, level count), then every page of every
+    // level, finest level first and row by row within a level, each page pageSize * pageSize ARGB8888 texels.
+    // Pages on the right and bottom edges are padded with copies of the last column and row.
+    const uint32_t fileMagic = 0x54564E52; // "RNVT"
+    const uint32_t fileVersion = 1;
+    const size_t headerWords = 6;
+
+    struct LevelSize {
+        size_t width;
+        size_t height;
+    };
+
+    // The same sizes as TextureMap::buildMipmaps: halved, rounding down, until 1x1
+    std::vector<LevelSize> levelSizes(size_t width, size_t height) {
+        std::vector<LevelSize> sizes{{width, height}};
+        while (sizes.back().width > 1 || sizes.back().height > 1) {
+            sizes.push_back({std::max<size_t>(1, sizes.back().width / 2), std::max<size_t>(1, sizes.back().height / 2)});
+        }
+        return sizes;
+    }
+
+    size_t pagesAcross(size_t texels, size_t pageSize) {
+        return (texels + pageSize - 1) / pageSize;
+    }
+
+    std::streamoff pageOffset(size_t page, size_t pageSize) {
+        return std::streamoff(headerWords * sizeof(uint32_t) + page * pageSize * pageSize * sizeof(uint32_t));
+    }
+
+    // repeat addressing, also for negative coordinates, with a mask for power of two sizes
+    size_t wrap(int coordinate, size_t size) {
+        if (size_t(coordinate) < size) return size_t(coordinate);
+        if ((size & (size - 1)) == 0) return size_t(coordinate) & (size - 1);
+        int wrapped = coordinate % int(size);
+        return wrapped < 0 ? wrapped + size : wrapped;
+    }
+
+    // Writes `rows` rows of `width` texels as page row `pageRow` of the level starting at page `firstPage`
+    void writePageRow(std::fstream &file, size_t firstPage, size_t width, size_t pageSize, size_t pageRow,
+                      const std::vector<uint32_t> &band, size_t rows) {
+        std::vector<uint32_t> page(pageSize * pageSize);
+        size_t pagesX = pagesAcross(width, pageSize);
+        for (size_t pageX = 0; pageX < pagesX; pageX++) {
+            for (size_t y = 0; y < pageSize; y++) {
+                size_t row = std::min(y, rows - 1);
+                for (size_t x = 0; x < pageSize; x++) {
+                    page[x + y * pageSize] = band[std::min(pageX * pageSize + x, width - 1) + row * width];
+                }
+            }
+            file.seekp(pageOffset(firstPage + pageRow * pagesX + pageX, pageSize));
+            file.write(reinterpret_cast<const char *>(page.data()), page.size() * sizeof(uint32_t));
+        }
+    }
+
+    // Reads rows [first, first + count) of a level that has already been written
+    void readRows(std::fstream &file, size_t firstPage, size_t width, size_t pageSize, size_t first, size_t count,
+                  std::vector<uint32_t> &rows) {
+        std::vector<uint32_t> page(pageSize * pageSize);
+        size_t pagesX = pagesAcross(width, pageSize);
+        rows.resize(width * count);
+        for (size_t pageY = first / pageSize; pageY <= (first + count - 1) / pageSize; pageY++) {
+            for (size_t pageX = 0; pageX < pagesX; pageX++) {
+                file.seekg(pageOffset(firstPage + pageY * pagesX + pageX, pageSize));
+                file.read(reinterpret_cast<char *>(page.data()), page.size() * sizeof(uint32_t));
+                for (size_t y = std::max(first, pageY * pageSize); y < std::min(first + count, (pageY + 1) * pageSize); y++) {
+                    size_t columns = std::min(pageSize, width - pageX * pageSize);
+                    std::copy_n(&page[(y - pageY * pageSize) * pageSize], columns, &rows[pageX * pageSize + (y - first) * width]);
+                }
+            }
+        }
+    }
+}
+
+void bakeVirtualTexture(const std::string &ppmFilename, const std::string &filename, size_t pageSize) {
+    TraceScope trace("bakeVirtualTexture", "io");
+    if (pageSize == 0 || (pageSize & (pageSize - 1)) != 0)
+        throw std::invalid_argument("Virtual texture page size " + std::to_string(pageSize) + " isn't a power of two");
+    std::ifstream ppm(ppmFilename, std::ifstream::binary);
+    if (!ppm) throw std::invalid_argument("Failed to open texture `" + ppmFilename + "`");
+    PpmHeader ppmHeader = readPpmHeader(ppm, ppmFilename);
+    std::fstream file(filename, std::fstream::in | std::fstream::out | std::fstream::binary | std::fstream::trunc);
+    if (!file) throw std::invalid_argument("Failed to create `" + filename + "`");
+
+    std::vector<LevelSize> sizes = levelSizes(ppmHeader.width, ppmHeader.height);
+    uint32_t header[headerWords] = {fileMagic, fileVersion, uint32_t(ppmHeader.width), uint32_t(ppmHeader.height),
+                                    uint32_t(pageSize), uint32_t(sizes.size())};
+    file.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+    // level 0, one row of pages at a time straight from the PPM
+    std::vector<unsigned char> payload(ppmHeader.width * ppmHeader.texelBytes());
+    std::vector<uint32_t> band(ppmHeader.width * pageSize);
+    for (size_t pageRow = 0; pageRow < pagesAcross(ppmHeader.height, pageSize); pageRow++) {
+        size_t rows = std::min(pageSize, ppmHeader.height - pageRow * pageSize);
+        for (size_t y = 0; y < rows; y++) {
+            if (!ppm.read(reinterpret_cast<char *>(payload.data()), payload.size()))
+                throw std::invalid_argument("`" + ppmFilename + "` ends at row " + std::to_string(pageRow * pageSize + y));
+            ppmToArgb(payload.data(), &band[y * ppmHeader.width], ppmHeader.width, ppmHeader.maxValue);
+        }
+        writePageRow(file, 0, ppmHeader.width, pageSize, pageRow, band, rows);
+    }
+
+    // every coarser level from the one before it, read back a row of pages at a time
+    size_t firstPage = 0;
+    std::vector<uint32_t> source;
+    for (size_t level = 1; level < sizes.size(); level++) {
+        LevelSize from = sizes[level - 1];
+        LevelSize to = sizes[level];
+        size_t fromFirstPage = firstPage;
+        firstPage += pagesAcross(from.width, pageSize) * pagesAcross(from.height, pageSize);
+        band.resize(to.width * pageSize);
+        for (size_t pageRow = 0; pageRow < pagesAcross(to.height, pageSize); pageRow++) {
+            size_t rows = std::min(pageSize, to.height - pageRow * pageSize);
+            size_t firstSourceRow = 2 * pageRow * pageSize;
+            size_t sourceRows = std::min(2 * rows, from.height - firstSourceRow);
+            readRows(file, fromFirstPage, from.width, pageSize, firstSourceRow, sourceRows, source);
+            for (size_t y = 0; y < rows; y++) {
+                // the same 2x2 box filter as TextureMap::buildMipmaps, clamped the same way
+                size_t y0 = std::min(2 * y, sourceRows - 1), y1 = std::min(2 * y + 1, sourceRows - 1);
+                for (size_t x = 0; x < to.width; x++) {
+                    size_t x0 = std::min(2 * x, from.width - 1), x1 = std::min(2 * x + 1, from.width - 1);
+                    uint32_t block[4] = {source[x0 + y0 * from.width], source[x1 + y0 * from.width],
+                                         source[x0 + y1 * from.width], source[x1 + y1 * from.width]};
+                    uint32_t red = 0, green = 0, blue = 0;
+                    for (uint32_t texel : block) {
+                        red += (texel >> 16) & 0xFF;
+                        green += (texel >> 8) & 0xFF;
+                        blue += texel & 0xFF;
+                    }
+                    band[x + y * to.width] = (255u << 24) + ((red + 2) / 4 << 16) + ((green + 2) / 4 << 8) + (blue + 2) / 4;
+                }
+            }
+            writePageRow(file, firstPage, to.width, pageSize, pageRow, band, rows);
+        }
+    }
+    if (!file) throw std::invalid_argument("Failed to write `" + filename + "`");
+}
+
+VirtualTexture::VirtualTexture(const std::string &filename, size_t cachePages)
+    : filename(filename), file(filename, std::ifstream::binary) {
+    uint32_t header[headerWords];
+    if (!file.read(reinterpret_cast<char *>(header), sizeof(header)) || header[0] != fileMagic || header[1] != fileVersion)
+        throw std::invalid_argument("`" + filename + "` isn't a virtual texture, see bakeVirtualTexture");
+    pageSize = header[4];
+    pageShift = 0;
+    while ((size_t(1) << pageShift) < pageSize) pageShift++;
+
+    size_t pageCount = 0;
+    for (LevelSize size : levelSizes(header[2], header[3])) {
+        levels.push_back({size.width, size.height, pagesAcross(size.width, pageSize), pageCount});
+        pageCount += pagesAcross(size.width, pageSize) * pagesAcross(size.height, pageSize);
+    }
+    if (levels.size() != header[5]) throw std::invalid_argument("`" + filename + "` has the wrong number of levels");
+
+    pageSlots.reset(new std::atomic<int32_t>[pageCount]);
+    pageLastUse.reset(new std::atomic<uint32_t>[pageCount]);
+    for (size_t page = 0; page < pageCount; page++) {
+        pageSlots[page] = -1;
+        pageLastUse[page] = 0;
+    }
+    pageStates.assign(pageCount, PAGE_ABSENT);
+    feedbackWords = (pageCount + 63) / 64;
+    feedback.reset(new std::atomic<uint64_t>[feedbackWords]);
+    for (size_t word = 0; word < feedbackWords; word++) feedback[word] = 0;
+
+    pool.resize(cachePages * pageSize * pageSize);
+    slotPages.assign(cachePages, -1);
+    slotPinned.assign(cachePages, false);
+
+    // the levels that fit in a single page are what every miss ends up falling back to
+    size_t firstPinned = levels.size();
+    while (firstPinned > 0 && levels[firstPinned - 1].width <= pageSize && levels[firstPinned - 1].height <= pageSize) firstPinned--;
+    if (levels.size() - firstPinned >= cachePages)
+        throw std::invalid_argument("A virtual texture cache of " + std::to_string(cachePages) + " pages can't hold `" + filename + "`");
+    std::vector<uint32_t> texels(pageSize * pageSize);
+    for (size_t level = firstPinned; level < levels.size(); level++) {
+        readPage(levels[level].firstPage, texels.data());
+        makeResident(levels[level].firstPage, texels.data(), true);
+    }
+    if (!file) throw std::invalid_argument("`" + filename + "` is truncated");
+}
+
+VirtualTexture::~VirtualTexture() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    // the reader job points at this texture
+    if (reader) jobs.wait(reader);
+}
+
+uint32_t VirtualTexture::texel(size_t level, int x, int y) const {
+    level = std::min(level, levels.size() - 1);
+    size_t texelX = wrap(x, levels[level].width);
+    size_t texelY = wrap(y, levels[level].height);
+    while (true) {
+        size_t page = pageIndex(level, texelX, texelY);
+        int32_t slot = pageSlots[page].load(std::memory_order_relaxed);
+        if (slot >= 0) {
+            if (pageLastUse[page].load(std::memory_order_relaxed) != frame) pageLastUse[page].store(frame, std::memory_order_relaxed);
+            size_t mask = pageSize - 1;
+            return pool[(size_t(slot) << (2 * pageShift)) + ((texelY & mask) << pageShift) + (texelX & mask)];
+        }
+        std::atomic<uint64_t> &word = feedback[page / 64];
+        uint64_t bit = uint64_t(1) << (page % 64);
+        if (!(word.load(std::memory_order_relaxed) & bit)) word.fetch_or(bit, std::memory_order_relaxed);
+        // the last level is pinned, so this ends there at the latest
+        level++;
+        texelX = std::min(texelX / 2, levels[level].width - 1);
+        texelY = std::min(texelY / 2, levels[level].height - 1);
+    }
+}
+
+uint32_t VirtualTexture::sampleNearest(size_t level, glm::vec2 uv) const {
+    const Level &l = levels[std::min(level, levels.size() - 1)];
+    return texel(level, int(std::floor(uv.x * l.width)), int(std::floor(uv.y * l.height)));
+}
+
+uint32_t VirtualTexture::sampleBilinear(size_t level, glm::vec2 uv) const {
+    const Level &l = levels[std::min(level, levels.size() - 1)];
+    // texel centres sit at half integers
+    float x = uv.x * l.width - 0.5f;
+    float y = uv.y * l.height - 0.5f;
+    int x0 = int(std::floor(x));
+    int y0 = int(std::floor(y));
+    float fx = x - x0;
+    float fy = y - y0;
+    uint32_t top = blendTexels(texel(level, x0, y0), texel(level, x0 + 1, y0), fx);
+    uint32_t bottom = blendTexels(texel(level, x0, y0 + 1), texel(level, x0 + 1, y0 + 1), fx);
+    return blendTexels(top, bottom, fy);
+}
+
+uint32_t VirtualTexture::sampleTrilinear(glm::vec2 uv, float lod) const {
+    if (lod <= 0) return sampleBilinear(0, uv);
+    size_t finer = size_t(lod);
+    if (finer + 1 >= levels.size()) return sampleBilinear(levels.size() - 1, uv);
+    return blendTexels(sampleBilinear(finer, uv), sampleBilinear(finer + 1, uv), lod - finer);
+}
+
+float VirtualTexture::mipLevel(glm::vec2 uvPerPixelX, glm::vec2 uvPerPixelY) const {
+    glm::vec2 size(width(), height());
+    glm::vec2 texelsX = uvPerPixelX * size, texelsY = uvPerPixelY * size;
+    float texelsPerPixelSquared = std::max(glm::dot(texelsX, texelsX), glm::dot(texelsY, texelsY));
+    if (texelsPerPixelSquared <= 1) return 0;
+    return std::min(0.5f * std::log2(texelsPerPixelSquared), float(levels.size() - 1));
+}
+
+void VirtualTexture::update() {
+    std::vector<Loaded> arrived;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        arrived.swap(loaded);
+    }
+    for (const Loaded &page : arrived) makeResident(page.page, page.texels.data(), false);
+
+    // Pages come after every page of the finer levels, so the highest numbers are the coarsest: load those first,
+    // as they improve the fallback for the most pixels
+    std::vector<size_t> wanted;
+    for (size_t word = 0; word < feedbackWords; word++) {
+        uint64_t bits = feedback[word].exchange(0, std::memory_order_relaxed);
+        for (size_t bit = 0; bits != 0; bit++, bits >>= 1) {
+            if ((bits & 1) && pageStates[word * 64 + bit] == PAGE_ABSENT) wanted.push_back(word * 64 + bit);
+        }
+    }
+    if (!wanted.empty()) {
+        std::sort(wanted.begin(), wanted.end(), std::greater<size_t>());
+        bool startReader;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t page : wanted) {
+                pageStates[page] = PAGE_QUEUED;
+                requests.push_back(page);
+            }
+            startReader = !reading;
+            reading = true;
+        }
+        if (startReader) reader = jobs.submit([this]() { readRequests(); });
+    }
+    frame++;
+}
+
+size_t VirtualTexture::residentPages() const {
+    return slotPages.size() - std::count(slotPages.begin(), slotPages.end(), -1);
+}
+
+size_t VirtualTexture::pendingPages() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return requests.size() + busy + loaded.size();
+}
+
+void VirtualTexture::waitForPages() const {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]() { return !reading; });
+}
+
+size_t VirtualTexture::pageIndex(size_t level, size_t x, size_t y) const {
+    const Level &l = levels[level];
+    return l.firstPage + (y >> pageShift) * l.pagesX + (x >> pageShift);
+}
+
+void VirtualTexture::readPage(size_t page, uint32_t *texels) {
+    file.seekg(pageOffset(page, pageSize));
+    file.read(reinterpret_cast<char *>(texels), pageSize * pageSize * sizeof(uint32_t));
+}
+
+// Puts a page in a free slot, or in place of the least recently sampled unpinned page
+void VirtualTexture::makeResident(size_t page, const uint32_t *texels, bool pinned) {
+    size_t slot = std::find(slotPages.begin(), slotPages.end(), -1) - slotPages.begin();
+    for (size_t candidate = 0; slot == slotPages.size() && candidate < slotPages.size(); candidate++) {
+        if (!slotPinned[candidate]) slot = candidate;
+    }
+    for (size_t candidate = slot + 1; slotPages[slot] >= 0 && candidate < slotPages.size(); candidate++) {
+        if (!slotPinned[candidate] && pageLastUse[slotPages[candidate]] < pageLastUse[slotPages[slot]]) slot = candidate;
+    }
+
+    if (slotPages[slot] >= 0) {
+        pageSlots[slotPages[slot]] = -1;
+        pageStates[slotPages[slot]] = PAGE_ABSENT;
+    }
+    std::memcpy(&pool[slot << (2 * pageShift)], texels, pageSize * pageSize * sizeof(uint32_t));
+    slotPages[slot] = int64_t(page);
+    slotPinned[slot] = pinned;
+    pageStates[page] = PAGE_RESIDENT;
+    pageLastUse[page] = frame;
+    pageSlots[page] = int32_t(slot);
+}
+
+void VirtualTexture::readRequests() {
+    std::vector<uint32_t> texels(pageSize * pageSize);
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping && !requests.empty()) {
+        size_t page = requests.front();
+        requests.pop_front();
+        busy++;
+        lock.unlock();
+        {
+            TraceScope trace("readPage", "io");
+            readPage(page, texels.data());
+        }
+        lock.lock();
+        loaded.push_back({page, texels});
+        busy--;
+    }
+    reading = false;
+    idle.notify_all();
+}
+
+namespace {
+    std::mutex registryMutex;
+    std::map<std::string, std::weak_ptr<VirtualTexture>> registry;
+}
+
+VirtualTextureHandle loadVirtualTexture(const std::string &filename) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (VirtualTextureHandle open = registry[filename].lock()) return open;
+    VirtualTextureHandle texture = std::make_shared<VirtualTexture>(filename);
+    registry[filename] = texture;
+    return texture;
+}
+
+void updateVirtualTextures() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto entry = registry.begin(); entry != registry.end();) {
+        if (VirtualTextureHandle texture = entry->second.lock()) {
+            texture->update();
+            ++entry;
+        } else {
+            entry = registry.erase(entry);
+        }
+    }
+}
+
+uint32_t sampleTexture(const VirtualTexture &texture, glm::vec2 uv, glm::vec2 uvPerPixelX, glm::vec2 uvPerPixelY, TextureFilter filter) {
+    if (filter == FILTER_NEAREST) return texture.sampleNearest(0, uv);
+    return sampleTexture(texture, uv, texture.mipLevel(uvPerPixelX, uvPerPixelY), filter);
+}
+
+uint32_t sampleTexture(const VirtualTexture &texture, glm::vec2 uv, float lod, TextureFilter filter) {
+    if (filter == FILTER_NEAREST) return texture.sampleNearest(0, uv);
+    if (filter == FILTER_BILINEAR) return texture.sampleBilinear(size_t(lod + 0.5f), uv);
+    return texture.sampleTrilinear(uv, lod);
+}
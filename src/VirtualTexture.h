@@ -0,0 +1,119 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "TextureSampler.h"
+#include <glm/glm.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Converts a PPM into a virtual texture file: every mip level (box filtered like TextureMap::buildMipmaps) cut into
+// pageSize x pageSize pages. It streams, holding a few rows of pages at a time, so the PPM can be bigger than RAM.
+// pageSize must be a power of two. Throws std::invalid_argument if either file can't be used.
+void bakeVirtualTexture(const std::string &ppmFilename, const std::string &filename, size_t pageSize = 128);
+
+// A baked texture whose pages are read from disk as they get sampled. Sampling records every page it wanted but
+// found missing, updateVirtualTextures (once per frame, between frames) queues those for a job to read and
+// copies the ones that have arrived into a fixed number of page slots, evicting the least recently sampled.
+// Until a page arrives, the nearest coarser resident level is sampled instead. Levels small enough to fit in one
+// page are loaded up front and never evicted, so there is always something to fall back to.
+class VirtualTexture {
+public:
+    // cachePages page slots are allocated up front (64 KB each for 128x128 pages)
+    VirtualTexture(const std::string &filename, size_t cachePages = 256);
+    ~VirtualTexture();
+    VirtualTexture(const VirtualTexture &) = delete;
+    VirtualTexture &operator=(const VirtualTexture &) = delete;
+
+    size_t width() const { return levels[0].width; }
+    size_t height() const { return levels[0].height; }
+    size_t levelCount() const { return levels.size(); }
+
+    // Texel (x, y) of `level`, repeating outside the texture, or of a coarser level if its page isn't resident
+    uint32_t texel(size_t level, int x, int y) const;
+    uint32_t sampleNearest(size_t level, glm::vec2 uv) const;
+    uint32_t sampleBilinear(size_t level, glm::vec2 uv) const;
+    uint32_t sampleTrilinear(glm::vec2 uv, float lod) const;
+    float mipLevel(glm::vec2 uvPerPixelX, glm::vec2 uvPerPixelY) const;
+
+    // Queues the pages sampled but missing since the last call and makes the loaded ones resident.
+    // Nothing may sample the texture while this runs.
+    void update();
+
+    size_t residentPages() const;
+    size_t pendingPages() const;
+    // Blocks until every queued page has been read (they still need an update() to become resident)
+    void waitForPages() const;
+
+private:
+    struct Level {
+        size_t width;
+        size_t height;
+        size_t pagesX;
+        size_t firstPage;
+    };
+
+    enum PageState : uint8_t { PAGE_ABSENT, PAGE_QUEUED, PAGE_RESIDENT };
+
+    struct Loaded {
+        size_t page;
+        std::vector<uint32_t> texels;
+    };
+
+    size_t pageIndex(size_t level, size_t x, size_t y) const;
+    void readPage(size_t page, uint32_t *texels);
+    void makeResident(size_t page, const uint32_t *texels, bool pinned);
+    // Reads queued pages until there are none left; only one runs at a time, as they share `file`
+    void readRequests();
+
+    std::string filename;
+    size_t pageSize;
+    size_t pageShift;
+    std::vector<Level> levels;
+
+    // Per page: its slot in `pool` (-1 while absent), written only by update(), and the frame it was last sampled in
+    std::unique_ptr<std::atomic<int32_t>[]> pageSlots;
+    std::unique_ptr<std::atomic<uint32_t>[]> pageLastUse;
+    std::vector<PageState> pageStates;
+    // One bit per page, set by samplers that wanted it while it wasn't resident
+    std::unique_ptr<std::atomic<uint64_t>[]> feedback;
+    size_t feedbackWords;
+
+    std::vector<uint32_t> pool;
+    // Per slot: the page in it (-1 if free) and whether it is pinned
+    std::vector<int64_t> slotPages;
+    std::vector<bool> slotPinned;
+    uint32_t frame = 1;
+
+    // Page reads: page numbers in, page texels out
+    std::ifstream file;
+    mutable std::mutex mutex;
+    mutable std::condition_variable idle;
+    std::deque<size_t> requests;
+    std::vector<Loaded> loaded;
+    size_t busy = 0;
+    // a readRequests job is queued or running
+    bool reading = false;
+    bool stopping = false;
+    JobHandle reader;
+};
+
+using VirtualTextureHandle = std::shared_ptr<VirtualTexture>;
+
+// Shared per file while any handle to it is alive, like loadMesh; map_Kd files ending in .vt load with this
+VirtualTextureHandle loadVirtualTexture(const std::string &filename);
+// VirtualTexture::update for every virtual texture alive, the viewer calls it after each frame
+void updateVirtualTextures();
+
+// Same as sampleTexture for a TextureMap
+uint32_t sampleTexture(const VirtualTexture &texture, glm::vec2 uv, glm::vec2 uvPerPixelX, glm::vec2 uvPerPixelY, TextureFilter filter);
+uint32_t sampleTexture(const VirtualTexture &texture, glm::vec2 uv, float lod, TextureFilter filter);
+inline float mipLevel(const VirtualTexture &texture, glm::vec2 uvPerPixelX, glm::vec2 uvPerPixelY) {
+    return texture.mipLevel(uvPerPixelX, uvPerPixelY);
+}